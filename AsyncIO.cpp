@@ -0,0 +1,374 @@
+#include "AsyncIO.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Size of the buffer handed to avio_alloc_context; the ring does the real buffering.
+constexpr int avioBufferSize = 64 * 1024;
+
+int seekFile(std::FILE* file, int64_t offset, int origin) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, origin);
+#else
+    return fseeko(file, static_cast<off_t>(offset), origin);
+#endif
+}
+
+int64_t tellFile(std::FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+std::FILE* openFile(const std::string& filename, const char* mode) {
+#ifdef _WIN32
+    std::FILE* file = nullptr;
+    return fopen_s(&file, filename.c_str(), mode) == 0 ? file : nullptr;
+#else
+    return std::fopen(filename.c_str(), mode);
+#endif
+}
+
+} // namespace
+
+AsyncInputFile::~AsyncInputFile() {
+    close();
+}
+
+// Opens the file, starts the read-ahead thread and wraps both in an AVIOContext.
+bool AsyncInputFile::open(const std::string& filename, size_t ringSize) {
+    file = openFile(filename, "rb");
+    if (!file) {
+        std::cerr << "Could not open input file: " << filename << std::endl;
+        return false;
+    }
+
+    fileSize = -1;
+    if (seekFile(file, 0, SEEK_END) == 0) {
+        fileSize = tellFile(file);
+    }
+    seekFile(file, 0, SEEK_SET);
+
+    uint8_t* avioBuffer = static_cast<uint8_t*>(av_malloc(avioBufferSize));
+    if (!avioBuffer) {
+        std::cerr << "Could not allocate input I/O buffer." << std::endl;
+        close();
+        return false;
+    }
+
+    ioContext = avio_alloc_context(avioBuffer, avioBufferSize, 0, this, &AsyncInputFile::readPacket, nullptr, &AsyncInputFile::seekPacket);
+    if (!ioContext) {
+        av_free(avioBuffer);
+        std::cerr << "Could not allocate input I/O context." << std::endl;
+        close();
+        return false;
+    }
+
+    ring.data.resize(ringSize);
+    ring.clear();
+    readPosition = 0;
+    generation = 0;
+    seekPending = false;
+    endOfFile = false;
+    ioError = false;
+    stopping = false;
+    worker = std::thread(&AsyncInputFile::readAheadLoop, this);
+    return true;
+}
+
+// Stops the read-ahead thread and releases the file and the AVIOContext.
+void AsyncInputFile::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    spaceReady.notify_all();
+    dataReady.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    if (ioContext) {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    ring.data.clear();
+    ring.clear();
+}
+
+// Keeps the ring filled ahead of the demuxer; seeks are carried out here so that the
+// file handle is only ever touched by this thread.
+void AsyncInputFile::readAheadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        if (seekPending) {
+            int64_t target = seekTarget;
+            seekPending = false;
+            lock.unlock();
+            bool failed = seekFile(file, target, SEEK_SET) != 0;
+            lock.lock();
+            if (failed) {
+                ioError = true;
+                dataReady.notify_all();
+            }
+            continue;
+        }
+
+        if (endOfFile || ioError || ring.freeSpace() == 0) {
+            spaceReady.wait(lock, [this] {
+                return stopping || seekPending || (!endOfFile && !ioError && ring.freeSpace() > 0);
+            });
+            continue;
+        }
+
+        size_t contiguous = 0;
+        uint8_t* target = ring.tail(contiguous);
+        size_t request = std::min(contiguous, defaultChunkSize);
+        uint64_t requestGeneration = generation;
+
+        lock.unlock();
+        size_t bytesRead = std::fread(target, 1, request, file);
+        bool failed = bytesRead < request && std::ferror(file);
+        lock.lock();
+
+        // A seek raced with this read; the data belongs to the old position.
+        if (requestGeneration != generation) {
+            continue;
+        }
+
+        ring.commit(bytesRead);
+        if (failed) {
+            ioError = true;
+        }
+        else if (bytesRead < request) {
+            endOfFile = true;
+        }
+        dataReady.notify_all();
+    }
+}
+
+int AsyncInputFile::read(uint8_t* buffer, int bufferSize) {
+    std::unique_lock<std::mutex> lock(mutex);
+    dataReady.wait(lock, [this] { return stopping || ring.size > 0 || endOfFile || ioError; });
+
+    if (ring.size == 0) {
+        return ioError ? AVERROR(EIO) : AVERROR_EOF;
+    }
+
+    int copied = 0;
+    while (copied < bufferSize && ring.size > 0) {
+        size_t contiguous = 0;
+        const uint8_t* source = ring.front(contiguous);
+        size_t bytes = std::min(contiguous, static_cast<size_t>(bufferSize - copied));
+        std::memcpy(buffer + copied, source, bytes);
+        ring.consume(bytes);
+        copied += static_cast<int>(bytes);
+    }
+    readPosition += copied;
+    spaceReady.notify_one();
+    return copied;
+}
+
+int64_t AsyncInputFile::seek(int64_t offset, int whence) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int64_t target = 0;
+    switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE: return fileSize >= 0 ? fileSize : AVERROR(ENOSYS);
+    case SEEK_SET: target = offset; break;
+    case SEEK_CUR: target = readPosition + offset; break;
+    case SEEK_END:
+        if (fileSize < 0) {
+            return AVERROR(ENOSYS);
+        }
+        target = fileSize + offset;
+        break;
+    default: return AVERROR(EINVAL);
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+
+    // Drop whatever was read ahead and let the worker restart from the new position.
+    ring.clear();
+    ++generation;
+    seekTarget = target;
+    seekPending = true;
+    endOfFile = false;
+    ioError = false;
+    readPosition = target;
+    spaceReady.notify_one();
+    return target;
+}
+
+int AsyncInputFile::readPacket(void* opaque, uint8_t* buffer, int bufferSize) {
+    return static_cast<AsyncInputFile*>(opaque)->read(buffer, bufferSize);
+}
+
+int64_t AsyncInputFile::seekPacket(void* opaque, int64_t offset, int whence) {
+    return static_cast<AsyncInputFile*>(opaque)->seek(offset, whence);
+}
+
+AsyncOutputFile::~AsyncOutputFile() {
+    close();
+}
+
+// Creates the file, starts the write-behind thread and wraps both in an AVIOContext.
+bool AsyncOutputFile::open(const std::string& filename, size_t ringSize) {
+    file = openFile(filename, "wb");
+    if (!file) {
+        std::cerr << "Could not open output file: " << filename << std::endl;
+        return false;
+    }
+
+    uint8_t* avioBuffer = static_cast<uint8_t*>(av_malloc(avioBufferSize));
+    if (!avioBuffer) {
+        std::cerr << "Could not allocate output I/O buffer." << std::endl;
+        close();
+        return false;
+    }
+
+    ioContext = avio_alloc_context(avioBuffer, avioBufferSize, 1, this, nullptr, &AsyncOutputFile::writePacket, &AsyncOutputFile::seekPacket);
+    if (!ioContext) {
+        av_free(avioBuffer);
+        std::cerr << "Could not allocate output I/O context." << std::endl;
+        close();
+        return false;
+    }
+
+    ring.data.resize(ringSize);
+    ring.clear();
+    writing = false;
+    ioError = false;
+    stopping = false;
+    worker = std::thread(&AsyncOutputFile::writeBehindLoop, this);
+    return true;
+}
+
+// Flushes everything still buffered to disk and releases the file and the AVIOContext.
+// Returns false if any write failed along the way.
+bool AsyncOutputFile::close() {
+    if (ioContext) {
+        avio_flush(ioContext);
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (worker.joinable()) {
+            waitForDrain(lock);
+        }
+        stopping = true;
+    }
+    dataReady.notify_all();
+    spaceReady.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+
+    bool success = !ioError;
+    if (ioContext) {
+        av_freep(&ioContext->buffer);
+        avio_context_free(&ioContext);
+    }
+    if (file) {
+        if (std::fclose(file) != 0) {
+            success = false;
+        }
+        file = nullptr;
+    }
+    ring.data.clear();
+    ring.clear();
+    return success;
+}
+
+// Drains the ring to disk in chunks while the muxer keeps producing.
+void AsyncOutputFile::writeBehindLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        dataReady.wait(lock, [this] { return stopping || ring.size > 0; });
+        if (ring.size == 0) {
+            break;
+        }
+
+        size_t contiguous = 0;
+        const uint8_t* source = ring.front(contiguous);
+        size_t request = std::min(contiguous, defaultChunkSize);
+        writing = true;
+
+        lock.unlock();
+        size_t bytesWritten = std::fwrite(source, 1, request, file);
+        lock.lock();
+
+        if (bytesWritten < request) {
+            ioError = true;
+        }
+        ring.consume(request);
+        writing = false;
+        spaceReady.notify_all();
+    }
+}
+
+void AsyncOutputFile::waitForDrain(std::unique_lock<std::mutex>& lock) {
+    spaceReady.wait(lock, [this] { return ring.size == 0 && !writing; });
+}
+
+int AsyncOutputFile::write(const uint8_t* buffer, int bufferSize) {
+    std::unique_lock<std::mutex> lock(mutex);
+    int copied = 0;
+    while (copied < bufferSize) {
+        spaceReady.wait(lock, [this] { return ioError || ring.freeSpace() > 0; });
+        if (ioError) {
+            return AVERROR(EIO);
+        }
+
+        size_t contiguous = 0;
+        uint8_t* target = ring.tail(contiguous);
+        size_t bytes = std::min(contiguous, static_cast<size_t>(bufferSize - copied));
+        std::memcpy(target, buffer + copied, bytes);
+        ring.commit(bytes);
+        copied += static_cast<int>(bytes);
+        dataReady.notify_one();
+    }
+    return copied;
+}
+
+// Muxers seek back to patch headers (e.g. the mp4 moov/mdat sizes); pending data is
+// written out first so the file position is unambiguous.
+int64_t AsyncOutputFile::seek(int64_t offset, int whence) {
+    std::unique_lock<std::mutex> lock(mutex);
+    waitForDrain(lock);
+    if (ioError) {
+        return AVERROR(EIO);
+    }
+
+    if ((whence & ~AVSEEK_FORCE) == AVSEEK_SIZE) {
+        int64_t current = tellFile(file);
+        if (seekFile(file, 0, SEEK_END) != 0) {
+            return AVERROR(EIO);
+        }
+        int64_t size = tellFile(file);
+        seekFile(file, current, SEEK_SET);
+        return size;
+    }
+
+    if (seekFile(file, offset, whence & ~AVSEEK_FORCE) != 0) {
+        return AVERROR(EIO);
+    }
+    return tellFile(file);
+}
+
+int AsyncOutputFile::writePacket(void* opaque, AVIOWriteBuffer buffer, int bufferSize) {
+    return static_cast<AsyncOutputFile*>(opaque)->write(buffer, bufferSize);
+}
+
+int64_t AsyncOutputFile::seekPacket(void* opaque, int64_t offset, int whence) {
+    return static_cast<AsyncOutputFile*>(opaque)->seek(offset, whence);
+}
@@ -0,0 +1,141 @@
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavformat/avio.h>
+    #include <libavutil/error.h>
+    #include <libavutil/mem.h>
+}
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// FFmpeg 7 (libavformat 61) made the write_packet buffer const.
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+using AVIOWriteBuffer = const uint8_t*;
+#else
+using AVIOWriteBuffer = uint8_t*;
+#endif
+
+// Fixed-capacity byte ring shared between the FFmpeg callbacks and the I/O thread.
+// head/size are only changed while holding the owning object's mutex; the I/O thread
+// may fill or drain the region it reserved without the lock.
+struct ByteRing {
+    std::vector<uint8_t> data;
+    size_t head = 0;
+    size_t size = 0;
+
+    size_t capacity() const { return data.size(); }
+    size_t freeSpace() const { return data.size() - size; }
+    void clear() { head = 0; size = 0; }
+
+    // Largest contiguous free region that starts at the tail of the ring.
+    uint8_t* tail(size_t& contiguous) {
+        size_t tailIndex = (head + size) % data.size();
+        contiguous = std::min(freeSpace(), data.size() - tailIndex);
+        return data.data() + tailIndex;
+    }
+
+    // Largest contiguous filled region that starts at the head of the ring.
+    const uint8_t* front(size_t& contiguous) const {
+        contiguous = std::min(size, data.size() - head);
+        return data.data() + head;
+    }
+
+    void commit(size_t bytes) { size += bytes; }
+    void consume(size_t bytes) { head = (head + bytes) % data.size(); size -= bytes; }
+};
+
+// Read-ahead input: a background thread keeps the ring filled from disk while the
+// demuxer consumes it through a custom AVIOContext.
+class AsyncInputFile {
+public:
+    static constexpr size_t defaultRingSize = 16 * 1024 * 1024;
+    static constexpr size_t defaultChunkSize = 1024 * 1024;
+
+    AsyncInputFile() = default;
+    ~AsyncInputFile();
+
+    AsyncInputFile(const AsyncInputFile&) = delete;
+    AsyncInputFile& operator=(const AsyncInputFile&) = delete;
+
+    bool open(const std::string& filename, size_t ringSize = defaultRingSize);
+    void close();
+
+    AVIOContext* context() const { return ioContext; }
+
+private:
+    std::FILE* file = nullptr;
+    AVIOContext* ioContext = nullptr;
+    int64_t fileSize = -1;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable dataReady;
+    std::condition_variable spaceReady;
+    ByteRing ring;
+    int64_t readPosition = 0;
+    int64_t seekTarget = 0;
+    uint64_t generation = 0;
+    bool seekPending = false;
+    bool endOfFile = false;
+    bool ioError = false;
+    bool stopping = false;
+
+    void readAheadLoop();
+    int read(uint8_t* buffer, int bufferSize);
+    int64_t seek(int64_t offset, int whence);
+
+    static int readPacket(void* opaque, uint8_t* buffer, int bufferSize);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+};
+
+// Write-behind output: the muxer writes into the ring and a background thread drains
+// it to disk, so storage latency overlaps with encoding.
+class AsyncOutputFile {
+public:
+    static constexpr size_t defaultRingSize = 16 * 1024 * 1024;
+    static constexpr size_t defaultChunkSize = 1024 * 1024;
+
+    AsyncOutputFile() = default;
+    ~AsyncOutputFile();
+
+    AsyncOutputFile(const AsyncOutputFile&) = delete;
+    AsyncOutputFile& operator=(const AsyncOutputFile&) = delete;
+
+    bool open(const std::string& filename, size_t ringSize = defaultRingSize);
+    bool close();
+
+    AVIOContext* context() const { return ioContext; }
+
+private:
+    std::FILE* file = nullptr;
+    AVIOContext* ioContext = nullptr;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable dataReady;
+    std::condition_variable spaceReady;
+    ByteRing ring;
+    bool writing = false;
+    bool ioError = false;
+    bool stopping = false;
+
+    void writeBehindLoop();
+    void waitForDrain(std::unique_lock<std::mutex>& lock);
+    int write(const uint8_t* buffer, int bufferSize);
+    int64_t seek(int64_t offset, int whence);
+
+    static int writePacket(void* opaque, AVIOWriteBuffer buffer, int bufferSize);
+    static int64_t seekPacket(void* opaque, int64_t offset, int whence);
+};
+
+#endif
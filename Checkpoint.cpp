@@ -0,0 +1,184 @@
+#include "Checkpoint.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool parseRational(const std::string& value, AVRational& rational) {
+    return std::sscanf(value.c_str(), "%d/%d", &rational.num, &rational.den) == 2 && rational.den != 0;
+}
+
+// Writes contents to path and waits until they are on disk.
+bool writeDurably(const std::string& path, const std::string& contents) {
+#ifdef _WIN32
+    std::FILE* file = nullptr;
+    if (fopen_s(&file, path.c_str(), "wb") != 0) {
+        file = nullptr;
+    }
+#else
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+#endif
+    if (!file) {
+        return false;
+    }
+    bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size() && std::fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0;
+#endif
+    return std::fclose(file) == 0 && written;
+}
+
+// Makes a rename in directory durable. Windows has no equivalent for directories.
+bool syncDirectory(const std::filesystem::path& directory) {
+#ifdef _WIN32
+    (void)directory;
+    return true;
+#else
+    int descriptor = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (descriptor < 0) {
+        return false;
+    }
+    bool synced = fsync(descriptor) == 0;
+    ::close(descriptor);
+    return synced;
+#endif
+}
+
+} // namespace
+
+bool CheckpointState::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+
+    CheckpointState state;
+    std::string line;
+    bool valid = true;
+    while (valid && std::getline(file, line)) {
+        size_t separator = line.find('=');
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::string key = line.substr(0, separator);
+        std::string value = line.substr(separator + 1);
+
+        try {
+            if (key == "segment_start") state.segmentStarts.push_back(std::stoll(value));
+            else if (key == "video_resume_pts") state.videoResumePts = std::stoll(value);
+            else if (key == "audio_resume_pts") state.audioResumePts = std::stoll(value);
+            else if (key == "output_bytes") state.outputBytes = std::stoll(value);
+            else if (key == "complete") state.complete = value == "1";
+            else if (key == "width") state.width = std::stoi(value);
+            else if (key == "height") state.height = std::stoi(value);
+            else if (key == "pix_fmt") state.pixelFormat = std::stoi(value);
+            else if (key == "video_time_base") valid = parseRational(value, state.videoTimeBase);
+            else if (key == "audio_time_base") valid = parseRational(value, state.audioTimeBase);
+            else if (key == "gop_size") state.gopSize = std::stoi(value);
+            else if (key == "max_b_frames") state.maxBFrames = std::stoi(value);
+            else if (key == "bit_rate") state.bitRate = std::stoll(value);
+            else if (key == "input_path") state.inputPath = value;
+            else if (key == "input_size") state.inputSize = std::stoll(value);
+            else if (key == "input_modified") state.inputModified = std::stoll(value);
+        }
+        catch (const std::exception&) {
+            valid = false;
+        }
+    }
+
+    if (!valid || state.segmentStarts.empty()) {
+        std::cerr << "Ignoring invalid checkpoint file: " << path << std::endl;
+        return false;
+    }
+
+    *this = state;
+    return true;
+}
+
+bool CheckpointState::save(const std::string& path) const {
+    std::ostringstream contents;
+    for (int64_t start : segmentStarts) {
+        contents << "segment_start=" << start << "\n";
+    }
+    contents << "video_resume_pts=" << videoResumePts << "\n"
+             << "audio_resume_pts=" << audioResumePts << "\n"
+             << "output_bytes=" << outputBytes << "\n"
+             << "complete=" << (complete ? 1 : 0) << "\n"
+             << "width=" << width << "\n"
+             << "height=" << height << "\n"
+             << "pix_fmt=" << pixelFormat << "\n"
+             << "video_time_base=" << videoTimeBase.num << "/" << videoTimeBase.den << "\n"
+             << "audio_time_base=" << audioTimeBase.num << "/" << audioTimeBase.den << "\n"
+             << "gop_size=" << gopSize << "\n"
+             << "max_b_frames=" << maxBFrames << "\n"
+             << "bit_rate=" << bitRate << "\n"
+             << "input_path=" << inputPath << "\n"
+             << "input_size=" << inputSize << "\n"
+             << "input_modified=" << inputModified << "\n";
+
+    // The contents have to be on disk before the rename, and the rename itself after it,
+    // or a crash could leave the new name pointing at an empty file.
+    std::string temporaryPath = path + ".tmp";
+    if (!writeDurably(temporaryPath, contents.str())) {
+        std::cerr << "Could not write checkpoint file: " << temporaryPath << std::endl;
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows.
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not update checkpoint file: " << path << std::endl;
+        return false;
+    }
+    if (!syncDirectory(std::filesystem::path(path).parent_path())) {
+        std::cerr << "Could not flush checkpoint file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void CheckpointState::identifyInput(const std::string& path) {
+    std::error_code error;
+    std::filesystem::path absolute = std::filesystem::absolute(path, error);
+    inputPath = error ? path : absolute.lexically_normal().string();
+    inputSize = -1;
+    inputModified = 0;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        return;
+    }
+    std::uintmax_t size = std::filesystem::file_size(path, error);
+    if (!error) {
+        inputSize = static_cast<int64_t>(size);
+    }
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, error);
+    if (!error) {
+        inputModified = static_cast<int64_t>(modified.time_since_epoch().count());
+    }
+}
+
+bool CheckpointState::sameInput(const CheckpointState& other) const {
+    return !inputPath.empty() && inputPath == other.inputPath &&
+           inputSize == other.inputSize && inputModified == other.inputModified;
+}
+
+bool CheckpointState::sameEncoderConfig(const CheckpointState& other) const {
+    return width == other.width && height == other.height && pixelFormat == other.pixelFormat &&
+           av_cmp_q(videoTimeBase, other.videoTimeBase) == 0 &&
+           av_cmp_q(audioTimeBase, other.audioTimeBase) == 0 &&
+           gopSize == other.gopSize && maxBFrames == other.maxBFrames && bitRate == other.bitRate;
+}
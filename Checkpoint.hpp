@@ -0,0 +1,48 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+extern "C"
+{
+    #include <libavutil/avutil.h>
+}
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Progress of a checkpointed rendition: how many closed-GOP segments are complete on
+// disk and where encoding resumes, plus the input and encoder configuration they were
+// made with. Stored as "key=value" lines next to the output file.
+struct CheckpointState {
+    std::vector<int64_t> segmentStarts;  // first video pts of each completed segment, encoder time base
+    int64_t videoResumePts = 0;          // first frame of the next segment, encoder time base
+    int64_t audioResumePts = 0;          // end of the audio already written, audio time base
+    int64_t outputBytes = 0;             // total size of the completed segments
+    bool complete = false;               // every segment is encoded, only joining them is left
+
+    int width = 0;
+    int height = 0;
+    int pixelFormat = -1;
+    AVRational videoTimeBase = { 0, 1 };
+    AVRational audioTimeBase = { 0, 1 };
+    int gopSize = 0;
+    int maxBFrames = 0;
+    int64_t bitRate = 0;
+
+    std::string inputPath;      // absolute path of the source
+    int64_t inputSize = -1;
+    int64_t inputModified = 0;  // last write time in file clock ticks
+
+    bool load(const std::string& path);
+    // Writes and syncs a temporary file, then renames it over path, so that a crash never
+    // leaves a torn state file.
+    bool save(const std::string& path) const;
+    // Fills the input fields from the file at path; inputs that are not regular files
+    // (e.g. URLs) are identified by name only.
+    void identifyInput(const std::string& path);
+    bool sameInput(const CheckpointState& other) const;
+    bool sameEncoderConfig(const CheckpointState& other) const;
+    int segments() const { return static_cast<int>(segmentStarts.size()); }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef COLORCOEFFICIENTS_H
+#define COLORCOEFFICIENTS_H
+
+// Pixel types and conversion matrices shared by ColorConversion and its per-ISA kernels.
+// Kept free of functions and heavy includes: the AVX2 kernel unit includes this header, and
+// any inline function with external linkage compiled there could replace the baseline copy
+// in the whole program.
+
+struct RGB {
+    double r, g, b;
+};
+
+struct YUV {
+    double y, u, v;
+};
+
+//Reference: https://en.wikipedia.org/wiki/Y%E2%80%B2UV
+// BT.2020 (Rec. 2020)
+// Usage:
+// Ultra High Definition TV = UHDTV
+struct BT2020 {
+    static constexpr double yr = 0.2627;
+    static constexpr double yg = 0.6780;
+    static constexpr double yb = 0.0593;
+    static constexpr double ur = -0.13963;
+    static constexpr double ug = -0.36037;
+    static constexpr double ub = 0.5;
+    static constexpr double vr = 0.5;
+    static constexpr double vg = -0.45979;
+    static constexpr double vb = -0.04021;
+};
+
+struct JPEG {
+    static constexpr double yr = 0.299;
+    static constexpr double yg = 0.587;
+    static constexpr double yb = 0.114;
+    static constexpr double ur = -0.168736; // Cbr
+    static constexpr double ug = -0.331264; // Cbg
+    static constexpr double ub = 0.5; // Cbb
+    static constexpr double vr = 0.5;
+    static constexpr double vg = -0.418688;
+    static constexpr double vb = -0.081312;
+};
+
+#endif // COLORCOEFFICIENTS_H
@@ -1,84 +1,52 @@
 #include "ColorConversion.hpp"
+#include "ColorConversionKernels.hpp"
+#include "CpuFeatures.hpp"
 
-void ColorConversion::convertRGBtoYUV_BT2020(const cv::Mat& rgbImage, cv::Mat& yuvImage) {
-    yuvImage = cv::Mat::zeros(rgbImage.size(), rgbImage.type());
-    int rows = rgbImage.rows;
-    int cols = rgbImage.cols;
-    int channels = rgbImage.channels();
-    std::cout << "Image Dimensions: " << rows << " x " << cols << "\n";
-
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            if (channels == 3) {
-                auto pixelValue = rgbImage.at<cv::Vec3b>(i, j);
-                RGB rgb = {
-                    pixelValue[0] / 255.0,
-                    pixelValue[1] / 255.0,
-                    pixelValue[2] / 255.0
-                };
-                auto yuv = rgbToYuv<BT2020>(rgb);
-                yuv.y = yuv.y * 255.0;
-                yuv.u = yuv.u * 255.0 + 128.0;
-                yuv.v = yuv.v * 255.0 + 128.0;
+namespace {
 
-                yuvImage.at<cv::Vec3b>(i, j)[0] = static_cast<uchar>(yuv.y);
-                yuvImage.at<cv::Vec3b>(i, j)[1] = static_cast<uchar>(yuv.u);
-                yuvImage.at<cv::Vec3b>(i, j)[2] = static_cast<uchar>(yuv.v);
-            }
+// Picked once, on first use, from the kernels this binary was built with.
+const ColorConversionKernels& kernels() {
+    static const ColorConversionKernels& selected = [] () -> const ColorConversionKernels& {
+        const ColorConversionKernels* avx2 = avx2ColorConversionKernels();
+        if (avx2 && cpuSupportsAVX2()) {
+            return *avx2;
         }
-    }
+        return scalarColorConversionKernels();
+    }();
+    return selected;
 }
 
-void ColorConversion::convertRGBtoYUV(const cv::Mat& rgbImage, cv::Mat& yuvImage) {
+void convertRows(const cv::Mat& rgbImage, cv::Mat& yuvImage, ColorRowKernel kernel, bool verbose) {
     yuvImage = cv::Mat::zeros(rgbImage.size(), rgbImage.type());
     int rows = rgbImage.rows;
     int cols = rgbImage.cols;
     int channels = rgbImage.channels();
-    std::cout << "Image Dimensions: " << rows << " x " << cols << "\n";
+    if (verbose) {
+        std::cout << "Image Dimensions: " << rows << " x " << cols << "\n";
+    }
 
+    if (channels != 3) {
+        return;
+    }
     for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            if (channels == 3) {
-                auto pixelValue = rgbImage.at<cv::Vec3b>(i, j);
-                RGB rgb = {
-                    static_cast<int>(pixelValue[0]),
-                    static_cast<int>(pixelValue[1]),
-                    static_cast<int>(pixelValue[2])
-                };
-                auto yuv = rgbToYuv<BT2020>(rgb);
-                yuvImage.at<cv::Vec3b>(i, j)[0] = static_cast<uchar>(yuv.y);
-                yuvImage.at<cv::Vec3b>(i, j)[1] = static_cast<uchar>(yuv.u + 128);
-                yuvImage.at<cv::Vec3b>(i, j)[2] = static_cast<uchar>(yuv.v + 128);
-            }
-        }
+        kernel(rgbImage.ptr<uchar>(i), yuvImage.ptr<uchar>(i), cols);
     }
 }
 
-void ColorConversion::convertRGBtoYUV_JPEG(const cv::Mat& rgbImage, cv::Mat& yuvImage) {
-    yuvImage = cv::Mat::zeros(rgbImage.size(), rgbImage.type());
-    int rows = rgbImage.rows;
-    int cols = rgbImage.cols;
-    int channels = rgbImage.channels();
-    std::cout << "Image Dimensions: " << rows << " x " << cols << "\n";
+} // namespace
 
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            if (channels == 3) {
-                auto pixelValue = rgbImage.at<cv::Vec3b>(i, j);
-                RGB rgb = {
-                    pixelValue[0] / 255.0,
-                    pixelValue[1] / 255.0,
-                    pixelValue[2] / 255.0
-                };
-                auto yuv = rgbToYuv<JPEG>(rgb);
-                yuv.y = yuv.y * 255.0;
-                yuv.u = yuv.u * 255.0 + 128.0;
-                yuv.v = yuv.v * 255.0 + 128.0;
+const char* ColorConversion::kernelName() {
+    return kernels().isa;
+}
 
-                yuvImage.at<cv::Vec3b>(i, j)[0] = static_cast<uchar>(yuv.y);
-                yuvImage.at<cv::Vec3b>(i, j)[1] = static_cast<uchar>(yuv.u);
-                yuvImage.at<cv::Vec3b>(i, j)[2] = static_cast<uchar>(yuv.v);
-            }
-        }
-    }
-}
\ No newline at end of file
+void ColorConversion::convertRGBtoYUV_BT2020(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose) {
+    convertRows(rgbImage, yuvImage, kernels().bt2020, verbose);
+}
+
+void ColorConversion::convertRGBtoYUV(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose) {
+    convertRows(rgbImage, yuvImage, kernels().bt2020Unnormalized, verbose);
+}
+
+void ColorConversion::convertRGBtoYUV_JPEG(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose) {
+    convertRows(rgbImage, yuvImage, kernels().jpeg, verbose);
+}
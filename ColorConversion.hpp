@@ -4,13 +4,7 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 
-struct RGB {
-    double r, g, b;
-};
-
-struct YUV {
-    double y, u, v;
-};
+#include "ColorCoefficients.hpp"
 
 template <typename T>
 inline YUV rgbToYuv(RGB rgb) {
@@ -33,39 +27,16 @@ inline RGB yuvToRgb(YUV yuv) {
 
     return rgb;
 }
-//Reference: https://en.wikipedia.org/wiki/Y%E2%80%B2UV
-// BT.2020 (Rec. 2020)
-// Usage:
-// Ultra High Definition TV = UHDTV
-struct BT2020 {
-    static constexpr double yr = 0.2627;
-    static constexpr double yg = 0.6780;
-    static constexpr double yb = 0.0593;
-    static constexpr double ur = -0.13963;
-    static constexpr double ug = -0.36037;
-    static constexpr double ub = 0.5;
-    static constexpr double vr = 0.5;
-    static constexpr double vg = -0.45979;
-    static constexpr double vb = -0.04021;
-};
-
-struct JPEG {
-    static constexpr double yr = 0.299;
-    static constexpr double yg = 0.587;
-    static constexpr double yb = 0.114;
-    static constexpr double ur = -0.168736; // Cbr
-    static constexpr double ug = -0.331264; // Cbg
-    static constexpr double ub = 0.5; // Cbb
-    static constexpr double vr = 0.5;
-    static constexpr double vg = -0.418688;
-    static constexpr double vb = -0.081312;
-};
 
 class ColorConversion {
 public:
-    static void convertRGBtoYUV_BT2020(const cv::Mat& rgbImage, cv::Mat& yuvImage);
-    static void convertRGBtoYUV_JPEG(const cv::Mat& rgbImage, cv::Mat& yuvImage);
-    static void convertRGBtoYUV(const cv::Mat& rgbImage, cv::Mat& yuvImage);
+    // verbose prints the image dimensions; pass false when converting from several threads.
+    static void convertRGBtoYUV_BT2020(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose = true);
+    static void convertRGBtoYUV_JPEG(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose = true);
+    static void convertRGBtoYUV(const cv::Mat& rgbImage, cv::Mat& yuvImage, bool verbose = true);
+
+    // Instruction set of the row kernels selected at runtime, e.g. "avx2".
+    static const char* kernelName();
 };
 
 #endif // COLORCONVERSION_H
\ No newline at end of file
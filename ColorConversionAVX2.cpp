@@ -0,0 +1,36 @@
+#include "ColorConversionKernels.hpp"
+
+// Built with AVX2 enabled (-mavx2 / /arch:AVX2) so the compiler vectorises the shared
+// row templates for it. FMA is deliberately left off: contracting the multiply-adds
+// would change rounding and the output would no longer match the scalar kernels.
+
+#if defined(__AVX2__)
+
+namespace {
+
+void bt2020Row(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowNormalized<BT2020>(src, dst, width);
+}
+
+void bt2020UnnormalizedRow(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowUnnormalized<BT2020>(src, dst, width);
+}
+
+void jpegRow(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowNormalized<JPEG>(src, dst, width);
+}
+
+} // namespace
+
+const ColorConversionKernels* avx2ColorConversionKernels() {
+    static const ColorConversionKernels kernels = { "avx2", bt2020Row, bt2020UnnormalizedRow, jpegRow };
+    return &kernels;
+}
+
+#else
+
+const ColorConversionKernels* avx2ColorConversionKernels() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef COLORCONVERSIONKERNELS_H
+#define COLORCONVERSIONKERNELS_H
+
+#include <cstdint>
+
+#include "ColorCoefficients.hpp"
+
+// Row kernels behind ColorConversion. The same templates are compiled once per instruction
+// set in separate translation units (ColorConversionScalar.cpp, ColorConversionAVX2.cpp)
+// and ColorConversion picks the best table the CPU supports at runtime. Rows are packed
+// 3-channel 8-bit pixels.
+using ColorRowKernel = void (*)(const uint8_t* src, uint8_t* dst, int width);
+
+struct ColorConversionKernels {
+    const char* isa;
+    ColorRowKernel bt2020;
+    ColorRowKernel bt2020Unnormalized;
+    ColorRowKernel jpeg;
+};
+
+const ColorConversionKernels& scalarColorConversionKernels();
+// nullptr when the translation unit was not compiled with AVX2 enabled.
+const ColorConversionKernels* avx2ColorConversionKernels();
+
+// The templates below get internal linkage on purpose: each ISA translation unit must keep
+// its own copy instead of letting the linker merge them into whichever it sees first.
+namespace {
+
+// Same arithmetic, in the same order, as rgbToYuv() so every ISA yields identical output.
+template <typename T>
+inline YUV rowRgbToYuv(const RGB& rgb) {
+    return {
+        T::yr * rgb.r + T::yg * rgb.g + T::yb * rgb.b,
+        T::ur * rgb.r + T::ug * rgb.g + T::ub * rgb.b,
+        T::vr * rgb.r + T::vg * rgb.g + T::vb * rgb.b
+    };
+}
+
+// Channels are normalised to [0, 1] before conversion and scaled back afterwards.
+template <typename T>
+inline void convertRowNormalized(const uint8_t* src, uint8_t* dst, int width) {
+    for (int j = 0; j < width; ++j) {
+        RGB rgb = {
+            src[3 * j + 0] / 255.0,
+            src[3 * j + 1] / 255.0,
+            src[3 * j + 2] / 255.0
+        };
+        YUV yuv = rowRgbToYuv<T>(rgb);
+        dst[3 * j + 0] = static_cast<uint8_t>(yuv.y * 255.0);
+        dst[3 * j + 1] = static_cast<uint8_t>(yuv.u * 255.0 + 128.0);
+        dst[3 * j + 2] = static_cast<uint8_t>(yuv.v * 255.0 + 128.0);
+    }
+}
+
+// Channels are converted in their 0-255 range.
+template <typename T>
+inline void convertRowUnnormalized(const uint8_t* src, uint8_t* dst, int width) {
+    for (int j = 0; j < width; ++j) {
+        RGB rgb = {
+            static_cast<double>(src[3 * j + 0]),
+            static_cast<double>(src[3 * j + 1]),
+            static_cast<double>(src[3 * j + 2])
+        };
+        YUV yuv = rowRgbToYuv<T>(rgb);
+        dst[3 * j + 0] = static_cast<uint8_t>(yuv.y);
+        dst[3 * j + 1] = static_cast<uint8_t>(yuv.u + 128);
+        dst[3 * j + 2] = static_cast<uint8_t>(yuv.v + 128);
+    }
+}
+
+} // namespace
+
+#endif // COLORCONVERSIONKERNELS_H
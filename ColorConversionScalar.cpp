@@ -0,0 +1,24 @@
+#include "ColorConversionKernels.hpp"
+
+// Baseline kernels, built with the project's default instruction set.
+
+namespace {
+
+void bt2020Row(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowNormalized<BT2020>(src, dst, width);
+}
+
+void bt2020UnnormalizedRow(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowUnnormalized<BT2020>(src, dst, width);
+}
+
+void jpegRow(const uint8_t* src, uint8_t* dst, int width) {
+    convertRowNormalized<JPEG>(src, dst, width);
+}
+
+} // namespace
+
+const ColorConversionKernels& scalarColorConversionKernels() {
+    static const ColorConversionKernels kernels = { "scalar", bt2020Row, bt2020UnnormalizedRow, jpegRow };
+    return kernels;
+}
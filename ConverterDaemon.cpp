@@ -0,0 +1,907 @@
+#include "ConverterDaemon.hpp"
+
+#include <iostream>
+
+#ifndef _WIN32
+
+#include "ColorConversion.hpp"
+#include "HEVCAnalyzerFFmpeg.hpp"
+#include "HEVCParser.hpp"
+#include "VideoConverter.hpp"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+namespace {
+
+// Longest request line accepted from a client.
+constexpr size_t maxLineLength = 64 * 1024;
+
+volatile std::sig_atomic_t stopSignal = 0;
+
+void onStopSignal(int) {
+    stopSignal = 1;
+}
+
+// A JSON object whose string, number and boolean members can be read; nested values are
+// only skipped, which is all the protocol needs.
+class JsonObject {
+public:
+    bool parse(const std::string& text, std::string& error) {
+        this->text = &text;
+        position = 0;
+        values.clear();
+
+        skipSpace();
+        if (!expect('{')) {
+            error = "expected an object";
+            return false;
+        }
+        skipSpace();
+        if (peek() == '}') {
+            ++position;
+        }
+        else {
+            while (true) {
+                std::string key;
+                Value value;
+                skipSpace();
+                if (!parseString(key)) {
+                    error = "expected a string key";
+                    return false;
+                }
+                skipSpace();
+                if (!expect(':')) {
+                    error = "expected ':' after \"" + key + "\"";
+                    return false;
+                }
+                skipSpace();
+                if (!parseValue(value)) {
+                    error = "unsupported value for \"" + key + "\"";
+                    return false;
+                }
+                values[key] = value;
+                skipSpace();
+                if (expect(',')) {
+                    continue;
+                }
+                if (expect('}')) {
+                    break;
+                }
+                error = "expected ',' or '}'";
+                return false;
+            }
+        }
+        skipSpace();
+        if (position != text.size()) {
+            error = "trailing characters after the object";
+            return false;
+        }
+        return true;
+    }
+
+    bool has(const std::string& key) const {
+        auto value = values.find(key);
+        return value != values.end() && value->second.type != Value::Null;
+    }
+
+    std::string string(const std::string& key, const std::string& fallback = "") const {
+        auto value = values.find(key);
+        return value != values.end() && value->second.type == Value::String ? value->second.text : fallback;
+    }
+
+    // Reads a whole number of at least minimum into result, from a number or a numeric
+    // string; result keeps its value when the key is absent. Fills error on anything else.
+    bool integer(const std::string& key, int minimum, int& result, std::string& error) const {
+        auto value = values.find(key);
+        if (value == values.end() || value->second.type == Value::Null) {
+            return true;
+        }
+        const std::string& number = value->second.text;
+        char* end = nullptr;
+        errno = 0;
+        long parsed = std::strtol(number.c_str(), &end, 10);
+        bool valid = (value->second.type == Value::Number || value->second.type == Value::String) &&
+                     !number.empty() && *end == '\0' && errno != ERANGE && parsed >= minimum && parsed <= INT_MAX;
+        if (!valid) {
+            error = "invalid value for \"" + key + "\": expected a whole number of at least " + std::to_string(minimum);
+            return false;
+        }
+        result = static_cast<int>(parsed);
+        return true;
+    }
+
+    bool boolean(const std::string& key, bool fallback = false) const {
+        auto value = values.find(key);
+        return value != values.end() && value->second.type == Value::Boolean ? value->second.text == "true" : fallback;
+    }
+
+private:
+    struct Value {
+        enum Type { String, Number, Boolean, Nested, Null } type = Null;
+        std::string text;
+    };
+
+    const std::string* text = nullptr;
+    size_t position = 0;
+    std::map<std::string, Value> values;
+
+    char peek() const {
+        return position < text->size() ? (*text)[position] : '\0';
+    }
+
+    bool expect(char c) {
+        if (peek() != c) {
+            return false;
+        }
+        ++position;
+        return true;
+    }
+
+    void skipSpace() {
+        while (peek() == ' ' || peek() == '\t' || peek() == '\r' || peek() == '\n') {
+            ++position;
+        }
+    }
+
+    bool parseValue(Value& value) {
+        char c = peek();
+        if (c == '"') {
+            value.type = Value::String;
+            return parseString(value.text);
+        }
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            size_t start = position;
+            while (peek() != '\0' && std::strchr("+-.eE0123456789", peek())) {
+                ++position;
+            }
+            value.type = Value::Number;
+            value.text = text->substr(start, position - start);
+            return true;
+        }
+        for (const char* literal : { "true", "false", "null" }) {
+            size_t length = std::strlen(literal);
+            if (text->compare(position, length, literal) == 0) {
+                position += length;
+                value.type = literal[0] == 'n' ? Value::Null : Value::Boolean;
+                value.text = literal;
+                return true;
+            }
+        }
+        // Nested objects and arrays (e.g. "outputs" of a reply) are kept as raw text.
+        if (c == '[' || c == '{') {
+            size_t start = position;
+            if (!skipNested()) {
+                return false;
+            }
+            value.type = Value::Nested;
+            value.text = text->substr(start, position - start);
+            return true;
+        }
+        return false;
+    }
+
+    bool skipNested() {
+        int depth = 0;
+        std::string ignored;
+        do {
+            char c = peek();
+            if (c == '"') {
+                if (!parseString(ignored)) {
+                    return false;
+                }
+                continue;
+            }
+            if (c == '\0') {
+                return false;
+            }
+            if (c == '[' || c == '{') {
+                ++depth;
+            }
+            else if (c == ']' || c == '}') {
+                --depth;
+            }
+            ++position;
+        } while (depth > 0);
+        return true;
+    }
+
+    bool parseHex4(unsigned& code) {
+        if (position + 4 > text->size()) {
+            return false;
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = (*text)[position++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, unsigned code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        }
+        else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool parseString(std::string& out) {
+        if (!expect('"')) {
+            return false;
+        }
+        out.clear();
+        while (position < text->size()) {
+            char c = (*text)[position++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (position >= text->size()) {
+                return false;
+            }
+            char escaped = (*text)[position++];
+            switch (escaped) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                unsigned code = 0;
+                if (!parseHex4(code)) {
+                    return false;
+                }
+                // A high surrogate must be followed by the low half of the pair.
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    unsigned low = 0;
+                    if (!expect('\\') || !expect('u') || !parseHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                appendUtf8(out, code);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+};
+
+// Builds one reply object; line() closes it and appends the newline that frames it.
+class JsonWriter {
+public:
+    JsonWriter& field(const char* key, const std::string& value) {
+        return raw(key, quote(value));
+    }
+
+    JsonWriter& number(const char* key, double value) {
+        // JSON has no infinity, e.g. the PSNR of identical frames.
+        if (!std::isfinite(value)) {
+            return raw(key, "null");
+        }
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.6g", value);
+        return raw(key, text);
+    }
+
+    JsonWriter& integer(const char* key, int64_t value) {
+        return raw(key, std::to_string(value));
+    }
+
+    JsonWriter& boolean(const char* key, bool value) {
+        return raw(key, value ? "true" : "false");
+    }
+
+    JsonWriter& raw(const char* key, const std::string& json) {
+        text += text.empty() ? "{" : ",";
+        text += quote(key);
+        text += ':';
+        text += json;
+        return *this;
+    }
+
+    std::string object() const {
+        return text.empty() ? "{}" : text + "}";
+    }
+
+    std::string line() const {
+        return object() + "\n";
+    }
+
+    static std::string array(const std::vector<std::string>& elements) {
+        std::string result = "[";
+        for (size_t i = 0; i < elements.size(); ++i) {
+            result += (i ? "," : "") + elements[i];
+        }
+        return result + "]";
+    }
+
+    static std::string quote(const std::string& value) {
+        std::string result = "\"";
+        for (unsigned char c : value) {
+            switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    result += escaped;
+                }
+                else {
+                    result += static_cast<char>(c);
+                }
+            }
+        }
+        return result + "\"";
+    }
+
+private:
+    std::string text;
+};
+
+JsonWriter reply(const std::string& id, const char* event) {
+    JsonWriter writer;
+    writer.field("id", id).field("event", event);
+    return writer;
+}
+
+// Owns one connected socket. Once the peer is gone further sends are dropped, so a client
+// that disconnects does not abort its job.
+class Client {
+public:
+    explicit Client(int socket) : socket(socket) {}
+    ~Client() { close(socket); }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    bool send(const std::string& line) {
+        size_t sent = 0;
+        while (connected && sent < line.size()) {
+            ssize_t written = write(socket, line.data() + sent, line.size() - sent);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                connected = false;
+                break;
+            }
+            sent += static_cast<size_t>(written);
+        }
+        return connected;
+    }
+
+    // Next line without its newline; a last line without one counts too.
+    bool readLine(std::string& line) {
+        while (true) {
+            size_t end = buffer.find('\n');
+            if (end != std::string::npos) {
+                line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                return true;
+            }
+            if (buffer.size() > maxLineLength) {
+                return false;
+            }
+            char chunk[4096];
+            ssize_t received = read(socket, chunk, sizeof(chunk));
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                line.swap(buffer);
+                buffer.clear();
+                return !line.empty();
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+private:
+    int socket;
+    bool connected = true;
+    std::string buffer;
+};
+
+bool fillAddress(const std::string& socketPath, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Invalid socket path: " << socketPath << std::endl;
+        return false;
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    return true;
+}
+
+bool runConvert(Client& client, const std::string& id, const JsonObject& request, VideoConverter& converter,
+                JsonWriter& done, std::string& error) {
+    std::string input = request.string("input");
+    std::string output = request.string("output");
+    if (input.empty() || output.empty()) {
+        error = "convert needs \"input\" and \"output\"";
+        return false;
+    }
+
+    ScalingOptions scaling;
+    if (request.has("size") && av_parse_video_size(&scaling.width, &scaling.height, request.string("size").c_str()) < 0) {
+        error = "invalid size: " + request.string("size");
+        return false;
+    }
+    if (request.has("pix_fmt")) {
+        scaling.pixelFormat = av_get_pix_fmt(request.string("pix_fmt").c_str());
+        if (scaling.pixelFormat == AV_PIX_FMT_NONE) {
+            error = "invalid pixel format: " + request.string("pix_fmt");
+            return false;
+        }
+    }
+    if (request.has("fps") && av_parse_video_rate(&scaling.frameRate, request.string("fps").c_str()) < 0) {
+        error = "invalid frame rate: " + request.string("fps");
+        return false;
+    }
+    int checkpointInterval = 0;
+    int qualityThreads = 0;
+    if (!request.integer("scale_threads", 0, scaling.threads, error) ||
+        !request.integer("checkpoint", 0, checkpointInterval, error) ||
+        !request.integer("quality_threads", 0, qualityThreads, error)) {
+        return false;
+    }
+
+    std::vector<Rendition> renditions;
+    if (request.has("ladder")) {
+        if (!parseLadder(request.string("ladder"), output, scaling, renditions)) {
+            error = "invalid ladder: " + request.string("ladder");
+            return false;
+        }
+    }
+    else {
+        renditions.push_back({ output, scaling });
+    }
+
+    converter.reset(input, renditions);
+    converter.setCheckpointInterval(checkpointInterval);
+    converter.setQualityMetrics(request.boolean("quality"), qualityThreads);
+    converter.setProgressCallback([&client, &id] (double fraction) {
+        client.send(reply(id, "progress").number("percent", fraction * 100).line());
+    });
+    bool converted = converter.convertToHEVC();
+    converter.setProgressCallback(nullptr);
+    if (!converted) {
+        error = "conversion failed, see the daemon log";
+        return false;
+    }
+
+    std::vector<std::string> outputs;
+    for (const Rendition& rendition : renditions) {
+        outputs.push_back(JsonWriter::quote(rendition.outputFilename));
+    }
+    done.raw("outputs", JsonWriter::array(outputs));
+
+    if (!converter.qualityReports().empty()) {
+        std::vector<std::string> quality;
+        for (const QualityReport& report : converter.qualityReports()) {
+            JsonWriter entry;
+            entry.field("output", report.outputFilename).integer("frames", report.summary.frames);
+            char key[16];
+            for (int plane = 0; plane < report.summary.planes; ++plane) {
+                std::snprintf(key, sizeof(key), "psnr_%s", QualityMeter::planeName(report.pixelFormat, plane));
+                entry.number(key, report.summary.plane[plane].psnr);
+            }
+            entry.number("psnr_all", report.summary.all.psnr);
+            for (int plane = 0; plane < report.summary.planes; ++plane) {
+                std::snprintf(key, sizeof(key), "ssim_%s", QualityMeter::planeName(report.pixelFormat, plane));
+                entry.number(key, report.summary.plane[plane].ssim);
+            }
+            entry.number("ssim_all", report.summary.all.ssim);
+            quality.push_back(entry.object());
+        }
+        done.raw("quality", JsonWriter::array(quality));
+    }
+    return true;
+}
+
+bool runAnalyze(const JsonObject& request, HEVCAnalyzerFFmpeg& analyzer, JsonWriter& done, std::string& error) {
+    std::string input = request.string("input");
+    if (input.empty()) {
+        error = "analyze needs \"input\"";
+        return false;
+    }
+
+    HEVCResult<StreamInfo> info = analyzer.analyze(input.c_str(), false);
+    if (!info) {
+        error = toString(info.error());
+        return false;
+    }
+    done.field("codec", std::string(info->codecName))
+        .integer("width", info->width)
+        .integer("height", info->height)
+        .number("frame_rate", info->frameRate)
+        .integer("duration", info->duration)
+        .integer("bit_rate", info->bitRate)
+        .integer("profile", info->profile)
+        .integer("level", info->level)
+        .field("color_range", std::string(info->colorRange));
+
+    // HEVC streams also get the fields read from the SPS itself.
+    if (info->codecName == "hevc") {
+        HEVCParser parser(input);
+        HEVCResult<HEVCInfo> sps = parser.parse();
+        if (sps) {
+            JsonWriter fields;
+            fields.integer("profile_space", sps->profileSpace)
+                .boolean("tier", sps->tierFlag)
+                .integer("profile_idc", sps->profileIdc)
+                .integer("level_idc", sps->levelIdc)
+                .integer("chroma_format_idc", sps->chromaFormatIdc)
+                .integer("bit_depth_luma", sps->bitDepthLuma)
+                .integer("bit_depth_chroma", sps->bitDepthChroma);
+            done.raw("sps", fields.object());
+        }
+        else {
+            done.field("sps_error", toString(sps.error()));
+        }
+    }
+    return true;
+}
+
+bool runImage(const JsonObject& request, JsonWriter& done, std::string& error) {
+    std::string input = request.string("input");
+    std::string output = request.string("output");
+    if (input.empty() || output.empty()) {
+        error = "image needs \"input\" and \"output\"";
+        return false;
+    }
+    std::string model = request.string("model", "jpeg");
+    if (model != "jpeg" && model != "bt2020" && model != "bt2020-unnormalized") {
+        error = "unknown colour model: " + model;
+        return false;
+    }
+
+    cv::Mat rgbImage = cv::imread(input);
+    if (rgbImage.empty()) {
+        error = "could not open or find the image " + input;
+        return false;
+    }
+    cv::Mat yuvImage;
+    if (model == "bt2020") {
+        ColorConversion::convertRGBtoYUV_BT2020(rgbImage, yuvImage, false);
+    }
+    else if (model == "bt2020-unnormalized") {
+        ColorConversion::convertRGBtoYUV(rgbImage, yuvImage, false);
+    }
+    else {
+        ColorConversion::convertRGBtoYUV_JPEG(rgbImage, yuvImage, false);
+    }
+    if (!cv::imwrite(output, yuvImage)) {
+        error = "failed to save the image " + output;
+        return false;
+    }
+    done.integer("width", rgbImage.cols)
+        .integer("height", rgbImage.rows)
+        .field("kernels", ColorConversion::kernelName());
+    return true;
+}
+
+void serveConnection(int socket, VideoConverter& converter, HEVCAnalyzerFFmpeg& analyzer) {
+    Client client(socket);
+    std::string line;
+    if (!client.readLine(line)) {
+        client.send(reply("", "error").field("message", "no request received").line());
+        return;
+    }
+    JsonObject request;
+    std::string error;
+    if (!request.parse(line, error)) {
+        client.send(reply("", "error").field("message", "invalid request: " + error).line());
+        return;
+    }
+
+    std::string id = request.string("id");
+    std::string type = request.string("type");
+    client.send(reply(id, "accepted").field("type", type).line());
+
+    auto start = std::chrono::steady_clock::now();
+    JsonWriter done = reply(id, "done");
+    bool success = false;
+    if (type == "convert") {
+        success = runConvert(client, id, request, converter, done, error);
+    }
+    else if (type == "analyze") {
+        success = runAnalyze(request, analyzer, done, error);
+    }
+    else if (type == "image") {
+        success = runImage(request, done, error);
+    }
+    else {
+        error = "unknown job type \"" + type + "\"";
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (success) {
+        client.send(done.number("seconds", elapsed.count()).line());
+        std::cout << "Job " << id << " (" << type << ") done in " << elapsed.count() << " s" << std::endl;
+    }
+    else {
+        client.send(reply(id, "error").field("message", error).line());
+        std::cerr << "Job " << id << " (" << type << ") failed: " << error << std::endl;
+    }
+}
+
+} // namespace
+
+ConverterDaemon::ConverterDaemon(const std::string& socketPath, int workers)
+    : socketPath(socketPath), workerCount(workers > 0 ? workers : defaultWorkers) {
+}
+
+ConverterDaemon::~ConverterDaemon() {
+    stop();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    if (listenSocket >= 0) {
+        close(listenSocket);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool ConverterDaemon::listen() {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) {
+        return false;
+    }
+
+    // A socket file left by a daemon that died is replaced; one that still answers is not.
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0) {
+        bool answered = connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        close(probe);
+        if (answered) {
+            std::cerr << "A daemon is already running on " << socketPath << std::endl;
+            return false;
+        }
+    }
+    // Anything else at that path is not ours to delete.
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << socketPath << " exists and is not a socket" << std::endl;
+            return false;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket < 0) {
+        std::cerr << "Could not create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    // Only the user running the daemon may submit jobs.
+    mode_t previousMask = umask(0077);
+    int bound = bind(listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    umask(previousMask);
+    if (bound < 0 || ::listen(listenSocket, SOMAXCONN) < 0) {
+        std::cerr << "Could not listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    return true;
+}
+
+bool ConverterDaemon::run() {
+    if (!listen()) {
+        return false;
+    }
+
+    // A client that goes away mid-job must not take the daemon with it.
+    std::signal(SIGPIPE, SIG_IGN);
+    stopSignal = 0;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+    av_log_set_level(AV_LOG_INFO);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&ConverterDaemon::workerLoop, this);
+    }
+    std::cout << "Listening on " << socketPath << " with " << workerCount << " workers" << std::endl;
+
+    while (!stopSignal) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) {
+                break;
+            }
+        }
+        // Wake up regularly to notice stop() and signals.
+        pollfd listener = { listenSocket, POLLIN, 0 };
+        int ready = poll(&listener, 1, 500);
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "Waiting for connections failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (ready <= 0) {
+            continue;
+        }
+        int connection = accept(listenSocket, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+        // A client gets this long to send its request before the worker gives up on it.
+        timeval timeout = { 10, 0 };
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.push_back(connection);
+        }
+        connectionReady.notify_one();
+    }
+
+    std::cout << "Stopping, waiting for running jobs" << std::endl;
+    stop();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    close(listenSocket);
+    listenSocket = -1;
+    unlink(socketPath.c_str());
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    return true;
+}
+
+void ConverterDaemon::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    connectionReady.notify_all();
+}
+
+void ConverterDaemon::workerLoop() {
+    // Kept warm between jobs. Workers run side by side, so results only go to the clients.
+    VideoConverter converter;
+    converter.setVerbose(false);
+    HEVCAnalyzerFFmpeg analyzer;
+
+    while (true) {
+        int connection = -1;
+        bool shuttingDown = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            connectionReady.wait(lock, [this] { return stopping || !connections.empty(); });
+            if (connections.empty()) {
+                return;
+            }
+            connection = connections.front();
+            connections.pop_front();
+            shuttingDown = stopping;
+        }
+        // Jobs still queued at shutdown are turned away rather than started.
+        if (shuttingDown) {
+            Client client(connection);
+            client.send(reply("", "error").field("message", "daemon is shutting down").line());
+            continue;
+        }
+        serveConnection(connection, converter, analyzer);
+    }
+}
+
+bool ConverterDaemon::submit(const std::string& socketPath, const std::string& request) {
+    sockaddr_un address;
+    if (!fillAddress(socketPath, address)) {
+        return false;
+    }
+    int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connection < 0 || connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "Could not connect to a daemon on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        if (connection >= 0) {
+            close(connection);
+        }
+        return false;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // The request must go out as a single line.
+    std::string line = request;
+    for (char& c : line) {
+        if (c == '\n' || c == '\r') {
+            c = ' ';
+        }
+    }
+    Client client(connection);
+    if (!client.send(line + "\n")) {
+        std::cerr << "Could not send the request to " << socketPath << std::endl;
+        return false;
+    }
+
+    std::string event;
+    std::string replyLine;
+    while (client.readLine(replyLine)) {
+        std::cout << replyLine << std::endl;
+        JsonObject parsed;
+        std::string error;
+        if (parsed.parse(replyLine, error)) {
+            event = parsed.string("event");
+        }
+    }
+    return event == "done";
+}
+
+#else
+
+ConverterDaemon::ConverterDaemon(const std::string& socketPath, int workers)
+    : socketPath(socketPath), workerCount(workers) {
+}
+
+ConverterDaemon::~ConverterDaemon() = default;
+
+bool ConverterDaemon::run() {
+    std::cerr << "The converter daemon needs Unix domain sockets and is not available on this platform" << std::endl;
+    return false;
+}
+
+void ConverterDaemon::stop() {
+}
+
+bool ConverterDaemon::listen() {
+    return false;
+}
+
+void ConverterDaemon::workerLoop() {
+}
+
+bool ConverterDaemon::submit(const std::string&, const std::string&) {
+    std::cerr << "The converter daemon needs Unix domain sockets and is not available on this platform" << std::endl;
+    return false;
+}
+
+#endif
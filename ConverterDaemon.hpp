@@ -0,0 +1,58 @@
+#ifndef CONVERTERDAEMON_H
+#define CONVERTERDAEMON_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Resident conversion service on a Unix domain socket (POSIX only). A client connects and
+// sends one JSON request on a single line, then reads JSON lines back: "accepted", any
+// number of "progress" events and a final "done" or "error". Jobs run on warm worker
+// threads, each keeping its converter (and the scaler contexts it pooled) between jobs, so a
+// job only pays for its own work.
+//
+//   {"id":"1","type":"convert","input":"in.mp4","output":"out.mp4","size":"1280x720","quality":true}
+//   {"id":"2","type":"analyze","input":"out.mp4"}
+//   {"id":"3","type":"image","input":"in.jpg","output":"out.jpg","model":"bt2020"}
+//
+// convert also takes "ladder", "pix_fmt", "fps", "scale_threads", "checkpoint" and
+// "quality_threads", with the meaning of the command line options of the same name; image
+// takes "model" jpeg (default), bt2020 or bt2020-unnormalized.
+class ConverterDaemon {
+public:
+    // Each conversion is multi-threaded by itself, so a few workers keep the machine busy.
+    static constexpr int defaultWorkers = 2;
+
+    explicit ConverterDaemon(const std::string& socketPath, int workers = defaultWorkers);
+    ~ConverterDaemon();
+
+    ConverterDaemon(const ConverterDaemon&) = delete;
+    ConverterDaemon& operator=(const ConverterDaemon&) = delete;
+
+    // Serves until stop(), SIGINT or SIGTERM; false if the socket could not be set up.
+    bool run();
+    void stop();
+
+    // Sends request to a running daemon and copies every reply line to std::cout. True
+    // when the job finished with "done".
+    static bool submit(const std::string& socketPath, const std::string& request);
+
+private:
+    std::string socketPath;
+    int workerCount;
+    int listenSocket = -1;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable connectionReady;
+    std::deque<int> connections;
+    bool stopping = false;
+
+    bool listen();
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+
+// Runtime instruction set checks for picking between per-ISA kernel translation units.
+bool cpuSupportsAVX2();
+
+#endif
@@ -0,0 +1,145 @@
+#include "FrameScaler.hpp"
+
+#include <iostream>
+
+SwsContextPool::~SwsContextPool() {
+    for (auto& entry : contexts) {
+        sws_freeContext(entry.second);
+    }
+}
+
+// sws_getCachedContext() cannot carry the "threads" option, so slice-threaded
+// contexts are built through the AVOptions API instead.
+SwsContext* SwsContextPool::createThreaded(const Key& key) {
+    SwsContext* context = sws_alloc_context();
+    if (!context) {
+        return nullptr;
+    }
+
+    av_opt_set_int(context, "srcw", std::get<0>(key), 0);
+    av_opt_set_int(context, "srch", std::get<1>(key), 0);
+    av_opt_set_int(context, "src_format", std::get<2>(key), 0);
+    av_opt_set_int(context, "dstw", std::get<3>(key), 0);
+    av_opt_set_int(context, "dsth", std::get<4>(key), 0);
+    av_opt_set_int(context, "dst_format", std::get<5>(key), 0);
+    av_opt_set_int(context, "sws_flags", flags, 0);
+    av_opt_set_int(context, "threads", threads, 0);
+
+    if (sws_init_context(context, nullptr, nullptr) < 0) {
+        sws_freeContext(context);
+        return nullptr;
+    }
+    return context;
+}
+
+SwsContext* SwsContextPool::acquire(int srcWidth, int srcHeight, AVPixelFormat srcFormat,
+                                    int dstWidth, int dstHeight, AVPixelFormat dstFormat) {
+    Key key(srcWidth, srcHeight, srcFormat, dstWidth, dstHeight, dstFormat);
+    // A long-lived pool would otherwise keep a context for every geometry it ever saw.
+    if (contexts.size() >= maxContexts && contexts.find(key) == contexts.end()) {
+        for (auto& entry : contexts) {
+            sws_freeContext(entry.second);
+        }
+        contexts.clear();
+    }
+    SwsContext*& context = contexts[key];
+    if (!context && threads != 1) {
+        context = createThreaded(key);
+    }
+
+    // Returns the pooled context untouched when its parameters match, otherwise
+    // (re)creates a single-threaded one.
+    context = sws_getCachedContext(context, srcWidth, srcHeight, srcFormat,
+                                   dstWidth, dstHeight, dstFormat, flags, nullptr, nullptr, nullptr);
+    return context;
+}
+
+bool FrameScaler::configure(const AVCodecContext* decoderContext, AVRational sourceFrameRate, AVRational sourceTimeBase) {
+    int sourceWidth = decoderContext->width;
+    int sourceHeight = decoderContext->height;
+    if (sourceWidth <= 0 || sourceHeight <= 0) {
+        std::cerr << "Invalid source dimensions for scaling." << std::endl;
+        return false;
+    }
+
+    width = options.width > 0 ? options.width : sourceWidth;
+    height = options.height > 0 ? options.height : sourceHeight;
+    if (options.width > 0 && options.height <= 0) {
+        height = static_cast<int>(av_rescale(width, sourceHeight, sourceWidth));
+    }
+    else if (options.height > 0 && options.width <= 0) {
+        width = static_cast<int>(av_rescale(height, sourceWidth, sourceHeight));
+    }
+
+    // Chroma-subsampled encoders require even dimensions.
+    width = FFMAX(2, width & ~1);
+    height = FFMAX(2, height & ~1);
+
+    pixelFormat = options.pixelFormat != AV_PIX_FMT_NONE ? options.pixelFormat : decoderContext->pix_fmt;
+
+    frameRate = sourceFrameRate;
+    if (options.frameRate.num > 0 && options.frameRate.den > 0 &&
+        (frameRate.num <= 0 || av_cmp_q(options.frameRate, frameRate) < 0)) {
+        frameRate = options.frameRate;
+    }
+    if (frameRate.num <= 0 || frameRate.den <= 0) {
+        std::cerr << "Could not determine output frame rate." << std::endl;
+        return false;
+    }
+
+    this->sourceTimeBase = sourceTimeBase;
+    lastOutputIndex = INT64_MIN;
+    return true;
+}
+
+int FrameScaler::process(const AVFrame* src, AVFrame* dst) {
+    // Map the source timestamp onto the output frame grid; a frame that lands on a slot
+    // already filled is dropped, which is how decimation happens.
+    int64_t timestamp = src->best_effort_timestamp != AV_NOPTS_VALUE ? src->best_effort_timestamp : src->pts;
+    int64_t outputIndex = lastOutputIndex == INT64_MIN ? 0 : lastOutputIndex + 1;
+    if (timestamp != AV_NOPTS_VALUE) {
+        outputIndex = av_rescale_q_rnd(timestamp, sourceTimeBase, outputTimeBase(),
+                                       static_cast<AVRounding>(AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX));
+    }
+    if (lastOutputIndex != INT64_MIN && outputIndex <= lastOutputIndex) {
+        return 0;
+    }
+
+    int ret = 0;
+    AVPixelFormat srcFormat = static_cast<AVPixelFormat>(src->format);
+    if (src->width == width && src->height == height && srcFormat == pixelFormat) {
+        ret = av_frame_ref(dst, src);
+        if (ret < 0) {
+            return ret;
+        }
+    }
+    else {
+        SwsContext* context = pool.acquire(src->width, src->height, srcFormat, width, height, pixelFormat);
+        if (!context) {
+            std::cerr << "Could not create scaling context." << std::endl;
+            return AVERROR(EINVAL);
+        }
+
+        dst->format = pixelFormat;
+        dst->width = width;
+        dst->height = height;
+        ret = av_frame_get_buffer(dst, 0);
+        if (ret < 0) {
+            return ret;
+        }
+        av_frame_copy_props(dst, src);
+
+        // sws_scale() only ever runs on the first slice context; sws_scale_frame() spreads
+        // the frame over the context's slice threads.
+        ret = sws_scale_frame(context, dst, src);
+        if (ret < 0) {
+            av_frame_unref(dst);
+            return ret;
+        }
+    }
+
+    dst->pts = outputIndex;
+    dst->pict_type = AV_PICTURE_TYPE_NONE;
+    lastOutputIndex = outputIndex;
+    return 1;
+}
@@ -0,0 +1,100 @@
+#ifndef FRAMESCALER_H
+#define FRAMESCALER_H
+
+extern "C"
+{
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+    #include <libavutil/frame.h>
+    #include <libavutil/opt.h>
+    #include <libavutil/parseutils.h>
+    #include <libavutil/pixdesc.h>
+    #include <libswscale/swscale.h>
+}
+
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+// Target of the scaling stage. Zero/none fields keep the source value; setting only one
+// of width/height derives the other from the source aspect ratio.
+struct ScalingOptions {
+    int width = 0;
+    int height = 0;
+    AVPixelFormat pixelFormat = AV_PIX_FMT_YUV420P;
+    AVRational frameRate = { 0, 1 };  // frames are only ever dropped, never duplicated
+    int threads = 0;                  // swscale slice threads, 0 = one per core
+    int flags = SWS_BICUBIC;
+};
+
+// SwsContext instances keyed by (src fmt, src size, dst fmt, dst size) so that
+// repeated conversions reuse an initialised context instead of rebuilding it.
+class SwsContextPool {
+public:
+    static constexpr size_t maxContexts = 16;
+
+    explicit SwsContextPool(int threads = 0, int flags = SWS_BICUBIC) : threads(threads), flags(flags) {}
+    ~SwsContextPool();
+
+    SwsContextPool(const SwsContextPool&) = delete;
+    SwsContextPool& operator=(const SwsContextPool&) = delete;
+
+    SwsContext* acquire(int srcWidth, int srcHeight, AVPixelFormat srcFormat,
+                        int dstWidth, int dstHeight, AVPixelFormat dstFormat);
+
+    // Whether contexts from this pool suit another user with these settings.
+    bool matches(int threads, int flags) const { return this->threads == threads && this->flags == flags; }
+
+private:
+    using Key = std::tuple<int, int, int, int, int, int>;
+
+    int threads;
+    int flags;
+    std::map<Key, SwsContext*> contexts;
+
+    SwsContext* createThreaded(const Key& key);
+};
+
+// Converts decoded frames to the encoder's resolution/pixel format and decimates them
+// to the target frame rate.
+class FrameScaler {
+public:
+    // A shared pool (created with the same threads/flags) keeps its contexts across
+    // scalers, e.g. from one job to the next; it must outlive the scaler.
+    explicit FrameScaler(const ScalingOptions& options = {}, SwsContextPool* sharedPool = nullptr)
+        : options(options), ownPool(options.threads, options.flags), pool(sharedPool ? *sharedPool : ownPool) {}
+
+    FrameScaler(const FrameScaler&) = delete;
+    FrameScaler& operator=(const FrameScaler&) = delete;
+
+    // Resolves the output geometry and timing from the decoder; must be called once
+    // before process().
+    bool configure(const AVCodecContext* decoderContext, AVRational sourceFrameRate, AVRational sourceTimeBase);
+
+    // Returns 1 with the converted frame in dst, 0 if the frame was dropped by
+    // decimation, or a negative AVERROR. dst pts is in outputTimeBase().
+    int process(const AVFrame* src, AVFrame* dst);
+
+    // Drops every frame that would land before outputIndex, e.g. when resuming a job.
+    void skipBefore(int64_t outputIndex) { lastOutputIndex = outputIndex - 1; }
+
+    int outputWidth() const { return width; }
+    int outputHeight() const { return height; }
+    AVPixelFormat outputPixelFormat() const { return pixelFormat; }
+    AVRational outputFrameRate() const { return frameRate; }
+    AVRational outputTimeBase() const { return av_inv_q(frameRate); }
+
+private:
+    ScalingOptions options;
+    SwsContextPool ownPool;
+    SwsContextPool& pool;
+
+    int width = 0;
+    int height = 0;
+    AVPixelFormat pixelFormat = AV_PIX_FMT_NONE;
+    AVRational frameRate = { 0, 1 };
+    AVRational sourceTimeBase = { 0, 1 };
+    int64_t lastOutputIndex = INT64_MIN;
+};
+
+#endif
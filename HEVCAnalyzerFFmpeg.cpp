@@ -1,7 +1,7 @@
 
 #include "HEVCAnalyzerFFmpeg.hpp"
 
-const char* HEVCAnalyzerFFmpeg::getColorRange(AVColorRange color_range) {
+std::string_view HEVCAnalyzerFFmpeg::getColorRange(AVColorRange color_range) noexcept {
     switch (color_range) {
     case AVCOL_RANGE_MPEG: return "MPEG";
     case AVCOL_RANGE_JPEG: return "JPEG";
@@ -10,19 +10,19 @@ const char* HEVCAnalyzerFFmpeg::getColorRange(AVColorRange color_range) {
     }
 }
 
-StreamInfo HEVCAnalyzerFFmpeg::analyze(const char* filename) {
+HEVCResult<StreamInfo> HEVCAnalyzerFFmpeg::analyze(const char* filename, bool verbose) {
     AVFormatContext* fmntCtx = nullptr;
-    StreamInfo info = { nullptr, 0, 0, 0.0, 0, 0, 0, 0, nullptr };
+    StreamInfo info = {};
 
     if (avformat_open_input(&fmntCtx, filename, nullptr, nullptr) < 0) {
         std::cerr << "Could not open source file " << filename << std::endl;
-        return info;
+        return HEVCError::OpenFailed;
     }
 
     if (avformat_find_stream_info(fmntCtx, nullptr) < 0) {
         std::cerr << "Could not find stream information" << std::endl;
         avformat_close_input(&fmntCtx);
-        return info;
+        return HEVCError::StreamInfoFailed;
     }
 
     const AVCodec* codec = nullptr;
@@ -30,7 +30,7 @@ StreamInfo HEVCAnalyzerFFmpeg::analyze(const char* filename) {
     if (streamIndex < 0) {
         std::cerr << "Could not find a video stream in the input file" << std::endl;
         avformat_close_input(&fmntCtx);
-        return info;
+        return HEVCError::NoVideoStream;
     }
 
     AVStream* stream = fmntCtx->streams[streamIndex];
@@ -47,6 +47,9 @@ StreamInfo HEVCAnalyzerFFmpeg::analyze(const char* filename) {
     info.colorRange = getColorRange(codecpar->color_range);
 
     avformat_close_input(&fmntCtx);
+    if (!verbose) {
+        return info;
+    }
     std::cout << "Printing video stream information collected with the use of FFmpeg library! " << std::endl;
     std::cout << "Code name: " << info.codecName << std::endl;
     std::cout << "Width: " << info.width << ", Height: " << info.height << std::endl;
@@ -10,9 +10,14 @@ extern "C" {
 }
 
 #include <iostream>
+#include <string_view>
 
+#include "HEVCParser.hpp"
+
+// The string fields view static strings owned by FFmpeg/this class and stay valid
+// after analyze() returns.
 struct StreamInfo {
-	const char* codecName;
+	std::string_view codecName;
 	int width;
 	int height;
 	double frameRate;
@@ -20,16 +25,17 @@ struct StreamInfo {
 	int64_t bitRate;
 	int profile;
 	int level;
-	const char* colorRange;
+	std::string_view colorRange;
 };
 
 
 class HEVCAnalyzerFFmpeg {
 public:
-	StreamInfo analyze(const char* filename);
+	// verbose prints the stream information; pass false when analysing from several threads.
+	HEVCResult<StreamInfo> analyze(const char* filename, bool verbose = true);
 
 private:
-	const char* getColorRange(AVColorRange colorRange);
+	static std::string_view getColorRange(AVColorRange colorRange) noexcept;
 };
 
 #endif
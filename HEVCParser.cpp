@@ -1,19 +1,127 @@
-
 #include "HEVCParser.hpp"
 #include <iostream>
-#include <stdexcept>
+
+namespace {
+
+constexpr int nalUnitTypeSps = 33;
+
+// MSB-first reader over an RBSP that still contains emulation prevention bytes; every
+// 0x000003 sequence is skipped on the fly so no unescaped copy has to be made. Reading
+// past the end sets the overflow flag and yields zeros instead of touching memory.
+class BitReader {
+public:
+    explicit BitReader(std::span<const uint8_t> data) noexcept : data(data) {}
+
+    uint32_t readBits(size_t numBits) noexcept {
+        uint32_t value = 0;
+        for (size_t i = 0; i < numBits; ++i) {
+            value = (value << 1) | readBit();
+        }
+        return value;
+    }
+
+    void skipBits(size_t numBits) noexcept {
+        for (size_t i = 0; i < numBits; ++i) {
+            readBit();
+        }
+    }
+
+    // ue(v); values that do not fit 32 bits are malformed for every field we read.
+    uint32_t readExpGolombCode() noexcept {
+        size_t leadingZeroBits = 0;
+        while (readBit() == 0) {
+            if (overflow || ++leadingZeroBits > 31) {
+                invalid = true;
+                return 0;
+            }
+        }
+        return static_cast<uint32_t>((uint64_t(1) << leadingZeroBits) - 1 + readBits(leadingZeroBits));
+    }
+
+    bool overflowed() const noexcept { return overflow; }
+    bool malformed() const noexcept { return invalid; }
+
+private:
+    std::span<const uint8_t> data;
+    size_t byteOffset = 0;
+    int bitInByte = 7;
+    int zeroRun = 0;
+    bool overflow = false;
+    bool invalid = false;
+
+    uint32_t readBit() noexcept {
+        if (bitInByte == 7) {
+            // Entering a new byte: drop it if it is an emulation prevention byte.
+            if (zeroRun >= 2 && byteOffset < data.size() && data[byteOffset] == 0x03) {
+                ++byteOffset;
+                zeroRun = 0;
+            }
+            if (byteOffset >= data.size()) {
+                overflow = true;
+                return 0;
+            }
+            zeroRun = data[byteOffset] == 0 ? zeroRun + 1 : 0;
+        }
+
+        uint32_t bit = (data[byteOffset] >> bitInByte) & 1;
+        if (--bitInByte < 0) {
+            bitInByte = 7;
+            ++byteOffset;
+        }
+        return bit;
+    }
+};
+
+int nalUnitType(std::span<const uint8_t> nalUnit) noexcept {
+    return nalUnit.empty() ? -1 : (nalUnit[0] >> 1) & 0x3F;
+}
+
+uint32_t readBigEndian(std::span<const uint8_t> data, size_t offset, size_t size) noexcept {
+    uint32_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+        value = (value << 8) | data[offset + i];
+    }
+    return value;
+}
+
+// Returns the offset just past the next 00 00 01 start code at or after offset, or data.size().
+size_t findStartCode(std::span<const uint8_t> data, size_t offset) noexcept {
+    for (size_t i = offset; i + 2 < data.size(); ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i + 3;
+        }
+    }
+    return data.size();
+}
+
+} // namespace
+
+const char* toString(HEVCError error) noexcept {
+    switch (error) {
+    case HEVCError::None: return "no error";
+    case HEVCError::Truncated: return "bitstream truncated";
+    case HEVCError::InvalidSyntax: return "invalid syntax element";
+    case HEVCError::NotSps: return "NAL unit is not an SPS";
+    case HEVCError::SpsNotFound: return "no SPS found";
+    case HEVCError::OpenFailed: return "failed to open file";
+    case HEVCError::StreamInfoFailed: return "failed to retrieve stream info";
+    case HEVCError::NoVideoStream: return "no video stream found";
+    case HEVCError::NotHevc: return "video stream is not HEVC";
+    }
+    return "unknown error";
+}
 
 HEVCParser::HEVCParser(const std::string& filename) : filename(filename) {}
 
-HEVCInfo HEVCParser::parse() {
+HEVCResult<HEVCInfo> HEVCParser::parse() {
     AVFormatContext* formatContext = avformat_alloc_context();
     if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) != 0) {
-        throw std::runtime_error("Failed to open file");
+        return HEVCError::OpenFailed;
     }
 
     if (avformat_find_stream_info(formatContext, nullptr) < 0) {
         avformat_close_input(&formatContext);
-        throw std::runtime_error("Failed to retrieve stream info");
+        return HEVCError::StreamInfoFailed;
     }
 
     AVCodecParameters* codecParams = nullptr;
@@ -28,115 +136,207 @@ HEVCInfo HEVCParser::parse() {
 
     if (videoStreamIndex == -1) {
         avformat_close_input(&formatContext);
-        throw std::runtime_error("No video stream found");
+        return HEVCError::NoVideoStream;
     }
 
     if (codecParams->codec_id != AV_CODEC_ID_HEVC) {
         avformat_close_input(&formatContext);
-        throw std::runtime_error("Video stream is not HEVC");
+        return HEVCError::NotHevc;
     }
 
-    HEVCInfo info = parseHevcSps(codecParams->extradata, codecParams->extradata_size);
+    HEVCResult<HEVCInfo> result = parseExtradata({ codecParams->extradata, static_cast<size_t>(codecParams->extradata_size) });
 
     avformat_close_input(&formatContext);
 
+    if (!result) {
+        return result;
+    }
+
+    const HEVCInfo& info = *result;
     std::cout << "Width: " << info.width << ", Height: " << info.height << std::endl;
     std::cout << "Profile Space: " << info.profileSpace << ", Tier Flag: " << info.tierFlag << std::endl;
     std::cout << "Profile IDC: " << info.profileIdc << ", Level IDC: " << info.levelIdc << std::endl;
     std::cout << "Chroma Format IDC: " << info.chromaFormatIdc << ", Bit Depth Luma: " << info.bitDepthLuma << std::endl;
     std::cout << "Bit Depth Chroma: " << info.bitDepthChroma << std::endl;
 
-    return info;
+    return result;
 }
 
-uint32_t HEVCParser::extractBits(const std::vector<uint8_t>& buffer, size_t& bitOffset, size_t numBits) {
-    uint32_t value = 0;
-    for (size_t i = 0; i < numBits; ++i) {
-        value <<= 1;
-        size_t byteOffset = bitOffset / 8;
-        size_t bitInByte = 7 - (bitOffset % 8);
-        if (buffer[byteOffset] & (1 << bitInByte)) {
-            value |= 1;
-        }
-        ++bitOffset;
+//Reference: https://www.itu.int/rec/T-REC-H.265 (7.3.2.2 seq_parameter_set_rbsp)
+HEVCResult<HEVCInfo> HEVCParser::parseSps(std::span<const uint8_t> nalUnit) noexcept {
+    // nal_unit_header: forbidden_zero_bit u(1), nal_unit_type u(6), nuh_layer_id u(6),
+    // nuh_temporal_id_plus1 u(3).
+    // 0-31 VCL
+    // 32 - 40 non-VCL
+    // 32 Video Parameter Set (VPS)
+    // 33 Sequence Parameter Set
+    if (nalUnit.size() < 2) {
+        return HEVCError::Truncated;
     }
-    return value;
-}
+    if (nalUnitType(nalUnit) != nalUnitTypeSps) {
+        return HEVCError::NotSps;
+    }
+
+    BitReader reader(nalUnit.subspan(2));
+    HEVCInfo info{};
 
-uint32_t HEVCParser::readExpGolombCode(const std::vector<uint8_t>& buffer, size_t& bitOffset) {
-    size_t leadingZeroBits = 0;
-    while (extractBits(buffer, bitOffset, 1) == 0) {
-        ++leadingZeroBits;
+    reader.skipBits(4); // sps_video_parameter_set_id
+    uint32_t spsMaxSubLayersMinus1 = reader.readBits(3);
+    reader.skipBits(1); // sps_temporal_id_nesting_flag
+    if (spsMaxSubLayersMinus1 > 6) {
+        return HEVCError::InvalidSyntax;
     }
-    uint32_t codeNum = (1 << leadingZeroBits) - 1 + extractBits(buffer, bitOffset, leadingZeroBits);
-    return codeNum;
-}
 
-//Reference: https://www.itu.int/rec/T-REC-H.265
-HEVCInfo HEVCParser::parseHevcSps(const uint8_t* data, size_t size) {
-    std::vector<uint8_t> buffer(data, data + size);
-    size_t bitOffset = 0; 
-    // forbidden_zero_bit 1 bit
-    // nal_unit_tpe 6 bits -> 64 possible tpyes!
+    // profile_tier_level(1, sps_max_sub_layers_minus1)
+    info.profileSpace = reader.readBits(2); // general_profile_space
+    info.tierFlag = reader.readBits(1);     // general_tier_flag
+    info.profileIdc = reader.readBits(5);   // general_profile_idc
+    reader.skipBits(32);                    // general_profile_compatibility_flag[32]
+    reader.skipBits(48);                    // progressive/interlaced/non_packed/frame_only + 44 constraint bits
+    info.levelIdc = reader.readBits(8);     // general_level_idc
 
-    // 0-31 VCL
-    // 32 - 40 non-VCL
-    // 35 Video Parameter Set (VPS)
-    // 33 Sequence Parameter Set
+    bool subLayerProfilePresent[8] = {};
+    bool subLayerLevelPresent[8] = {};
+    for (uint32_t i = 0; i < spsMaxSubLayersMinus1; ++i) {
+        subLayerProfilePresent[i] = reader.readBits(1);
+        subLayerLevelPresent[i] = reader.readBits(1);
+    }
+    if (spsMaxSubLayersMinus1 > 0) {
+        reader.skipBits(2 * (8 - spsMaxSubLayersMinus1)); // reserved_zero_2bits
+    }
+    for (uint32_t i = 0; i < spsMaxSubLayersMinus1; ++i) {
+        if (subLayerProfilePresent[i]) {
+            reader.skipBits(88);
+        }
+        if (subLayerLevelPresent[i]) {
+            reader.skipBits(8);
+        }
+    }
 
-    // Skip the NAL unit header (4 bytes or 32 bits).
-       bitOffset += 4 * 8;
-
-    HEVCInfo info;
-    // Extract SPS video parameter set ID (4 bits).
-    int spsVideoParameterSetId = extractBits(buffer, bitOffset, 4);
-    // Extract SPS max sub-layers minus 1 (3 bits).
-    int spsMaxSubLayersMinus1 = extractBits(buffer, bitOffset, 3);
-    // Extract SPS temporal ID nesting flag (1 bit).
-    int spsTemporalIdNestingFlag = extractBits(buffer, bitOffset, 1);
-
-    // Profile tier level information extraction.
-    info.profileSpace = extractBits(buffer, bitOffset, 2); // profile_space (2 bits)
-    info.tierFlag = extractBits(buffer, bitOffset, 1); // tier_flag (1 bit)
-    info.profileIdc = extractBits(buffer, bitOffset, 5); // profile_idc (5 bits)
-    bitOffset += 32; // Skipping some profile compatibility flags     // Skip 32 bits for profile compatibility flags.
-    bitOffset += 16; // Skipping more flags // Skip 16 bits for reserved fields and other flags.
-    // Level IDC (8 bits)
-    info.levelIdc = extractBits(buffer, bitOffset, 8);
-
-    // SPS sequence parameter set ID.
-    int spsSeqParameterSetId = readExpGolombCode(buffer, bitOffset);
-    // Chroma format IDC.
-    info.chromaFormatIdc = readExpGolombCode(buffer, bitOffset);
+    reader.readExpGolombCode(); // sps_seq_parameter_set_id
+    info.chromaFormatIdc = reader.readExpGolombCode();
+    if (info.chromaFormatIdc > 3) {
+        return reader.overflowed() ? HEVCError::Truncated : HEVCError::InvalidSyntax;
+    }
+    bool separateColourPlane = false;
     if (info.chromaFormatIdc == 3) {
-        // Separate colour plane flag (1 bit if chroma_format_idc is 3).
-        extractBits(buffer, bitOffset, 1); // separate_colour_plane_flag
+        separateColourPlane = reader.readBits(1); // separate_colour_plane_flag
     }
 
     // Picture width and height in luma samples.
-    int picWidthInLumaSamples = readExpGolombCode(buffer, bitOffset);
-    int picHeightInLumaSamples = readExpGolombCode(buffer, bitOffset);
+    uint32_t picWidthInLumaSamples = reader.readExpGolombCode();
+    uint32_t picHeightInLumaSamples = reader.readExpGolombCode();
 
-    // Conformance window flag (1 bit).
-    bool conformanceWindowFlag = extractBits(buffer, bitOffset, 1);
-    if (conformanceWindowFlag) {
-        // Conformance window offsets (exp-Golomb coded).
-        int confWinLeftOffset = readExpGolombCode(buffer, bitOffset);
-        int confWinRightOffset = readExpGolombCode(buffer, bitOffset);
-        int confWinTopOffset = readExpGolombCode(buffer, bitOffset);
-        int confWinBottomOffset = readExpGolombCode(buffer, bitOffset);
+    // Conformance window offsets are in chroma sample units (Table 6-1).
+    int chromaArrayType = separateColourPlane ? 0 : info.chromaFormatIdc;
+    uint32_t subWidthC = (chromaArrayType == 1 || chromaArrayType == 2) ? 2 : 1;
+    uint32_t subHeightC = chromaArrayType == 1 ? 2 : 1;
 
-        info.width = picWidthInLumaSamples - (confWinLeftOffset + confWinRightOffset);
-        info.height = picHeightInLumaSamples - (confWinTopOffset + confWinBottomOffset);
-    }
-    else {
-        info.width = picWidthInLumaSamples;
-        info.height = picHeightInLumaSamples;
+    uint64_t cropWidth = 0;
+    uint64_t cropHeight = 0;
+    if (reader.readBits(1)) { // conformance_window_flag
+        uint64_t confWinLeftOffset = reader.readExpGolombCode();
+        uint64_t confWinRightOffset = reader.readExpGolombCode();
+        uint64_t confWinTopOffset = reader.readExpGolombCode();
+        uint64_t confWinBottomOffset = reader.readExpGolombCode();
+        cropWidth = subWidthC * (confWinLeftOffset + confWinRightOffset);
+        cropHeight = subHeightC * (confWinTopOffset + confWinBottomOffset);
     }
+
     // Bit depth for luma and chroma samples
-    info.bitDepthLuma = readExpGolombCode(buffer, bitOffset) + 8;
-    info.bitDepthChroma = readExpGolombCode(buffer, bitOffset) + 8;
+    uint32_t bitDepthLumaMinus8 = reader.readExpGolombCode();
+    uint32_t bitDepthChromaMinus8 = reader.readExpGolombCode();
+
+    if (reader.overflowed()) {
+        return HEVCError::Truncated;
+    }
+    if (reader.malformed() || picWidthInLumaSamples == 0 || picHeightInLumaSamples == 0 ||
+        picWidthInLumaSamples > 16888 || picHeightInLumaSamples > 16888 ||
+        cropWidth >= picWidthInLumaSamples || cropHeight >= picHeightInLumaSamples ||
+        bitDepthLumaMinus8 > 8 || bitDepthChromaMinus8 > 8) {
+        return HEVCError::InvalidSyntax;
+    }
+
+    info.width = static_cast<int>(picWidthInLumaSamples - cropWidth);
+    info.height = static_cast<int>(picHeightInLumaSamples - cropHeight);
+    info.bitDepthLuma = static_cast<int>(bitDepthLumaMinus8) + 8;
+    info.bitDepthChroma = static_cast<int>(bitDepthChromaMinus8) + 8;
 
     // Return the extracted SPS information
     return info;
-}
\ No newline at end of file
+}
+
+HEVCResult<HEVCInfo> HEVCParser::parseExtradata(std::span<const uint8_t> extradata) noexcept {
+    // Annex B extradata starts with a start code; hvcC starts with configurationVersion 1.
+    if (extradata.size() < 3 || extradata[0] != 1) {
+        return parsePacket(extradata, 0);
+    }
+
+    // HEVCDecoderConfigurationRecord: 22 bytes of fixed fields, numOfArrays, then arrays
+    // of { type, numNalus, { nalUnitLength, nalUnit }... }.
+    if (extradata.size() < 23) {
+        return HEVCError::Truncated;
+    }
+    size_t offset = 23;
+    uint32_t numOfArrays = extradata[22];
+    for (uint32_t array = 0; array < numOfArrays; ++array) {
+        if (offset + 3 > extradata.size()) {
+            return HEVCError::Truncated;
+        }
+        int type = extradata[offset] & 0x3F;
+        uint32_t numNalus = readBigEndian(extradata, offset + 1, 2);
+        offset += 3;
+
+        for (uint32_t nalu = 0; nalu < numNalus; ++nalu) {
+            if (offset + 2 > extradata.size()) {
+                return HEVCError::Truncated;
+            }
+            size_t nalUnitLength = readBigEndian(extradata, offset, 2);
+            offset += 2;
+            if (offset + nalUnitLength > extradata.size()) {
+                return HEVCError::Truncated;
+            }
+            if (type == nalUnitTypeSps) {
+                return parseSps(extradata.subspan(offset, nalUnitLength));
+            }
+            offset += nalUnitLength;
+        }
+    }
+    return HEVCError::SpsNotFound;
+}
+
+HEVCResult<HEVCInfo> HEVCParser::parsePacket(std::span<const uint8_t> packet, int nalLengthSize) noexcept {
+    // hvcC's lengthSizeMinusOne allows 1, 2 or 4 byte lengths.
+    if (nalLengthSize != 0 && nalLengthSize != 1 && nalLengthSize != 2 && nalLengthSize != 4) {
+        return HEVCError::InvalidSyntax;
+    }
+
+    if (nalLengthSize > 0) {
+        size_t offset = 0;
+        while (offset + nalLengthSize <= packet.size()) {
+            size_t nalUnitLength = readBigEndian(packet, offset, nalLengthSize);
+            offset += nalLengthSize;
+            if (offset + nalUnitLength > packet.size()) {
+                return HEVCError::Truncated;
+            }
+            std::span<const uint8_t> nalUnit = packet.subspan(offset, nalUnitLength);
+            if (nalUnitType(nalUnit) == nalUnitTypeSps) {
+                return parseSps(nalUnit);
+            }
+            offset += nalUnitLength;
+        }
+        return HEVCError::SpsNotFound;
+    }
+
+    size_t start = findStartCode(packet, 0);
+    while (start < packet.size()) {
+        size_t next = findStartCode(packet, start);
+        // The NAL unit ends at the next start code; trailing zero bytes belong to it.
+        size_t end = next == packet.size() ? packet.size() : next - 3;
+        if (nalUnitType(packet.subspan(start, end - start)) == nalUnitTypeSps) {
+            return parseSps(packet.subspan(start, end - start));
+        }
+        start = next;
+    }
+    return HEVCError::SpsNotFound;
+}
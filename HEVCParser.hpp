@@ -7,8 +7,10 @@ extern "C" {
 #include <libavutil/avutil.h>
 }
 
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
-#include <vector>
 
 struct HEVCInfo {
     int width;
@@ -22,18 +24,62 @@ struct HEVCInfo {
     int bitDepthChroma;
 };
 
+enum class HEVCError {
+    None,
+    Truncated,          // the bitstream ended in the middle of a syntax element
+    InvalidSyntax,      // a value is outside the range the specification allows
+    NotSps,             // the NAL unit is not a sequence parameter set
+    SpsNotFound,        // no SPS in the extradata or packet
+    OpenFailed,
+    StreamInfoFailed,
+    NoVideoStream,
+    NotHevc,
+};
+
+const char* toString(HEVCError error) noexcept;
+
+// Value-or-error result in the spirit of std::expected (C++23), which this C++20 build
+// cannot use yet. Never allocates and never throws.
+template <typename T>
+class HEVCResult {
+public:
+    HEVCResult(const T& value) noexcept : storedValue(value), storedError(HEVCError::None) {}
+    HEVCResult(HEVCError error) noexcept : storedValue{}, storedError(error) {}
+
+    bool has_value() const noexcept { return storedError == HEVCError::None; }
+    explicit operator bool() const noexcept { return has_value(); }
+
+    const T& value() const noexcept { return storedValue; }
+    const T& operator*() const noexcept { return storedValue; }
+    const T* operator->() const noexcept { return &storedValue; }
+    HEVCError error() const noexcept { return storedError; }
+
+private:
+    T storedValue;
+    HEVCError storedError;
+};
+
 class HEVCParser {
 public:
     HEVCParser(const std::string& filename);
 
-    HEVCInfo parse();
+    // Opens the file with FFmpeg and parses the SPS carried in the video stream's extradata.
+    HEVCResult<HEVCInfo> parse();
+
+    // The functions below work on memory only: they do not allocate, do not throw and can
+    // be fed demuxer extradata and packets directly.
+
+    // One SPS NAL unit including its two byte NAL unit header, emulation prevention
+    // bytes still in place.
+    static HEVCResult<HEVCInfo> parseSps(std::span<const uint8_t> nalUnit) noexcept;
+    // Extradata in either hvcC (ISO/IEC 14496-15, as in mp4/mkv) or Annex B form.
+    static HEVCResult<HEVCInfo> parseExtradata(std::span<const uint8_t> extradata) noexcept;
+    // A packet with Annex B start codes (nalLengthSize == 0) or nalLengthSize-byte length
+    // prefixes (1, 2 or 4, as announced by hvcC); returns the first SPS it contains.
+    static HEVCResult<HEVCInfo> parsePacket(std::span<const uint8_t> packet, int nalLengthSize = 0) noexcept;
 
 private:
     std::string filename;
-
-    uint32_t extractBits(const std::vector<uint8_t>& buffer, size_t& bitOffset, size_t numBits);
-    uint32_t readExpGolombCode(const std::vector<uint8_t>& buffer, size_t& bitOffset);
-    HEVCInfo parseHevcSps(const uint8_t* data, size_t size);
 };
 
-#endif // HEVCPARSER_H
\ No newline at end of file
+#endif // HEVCPARSER_H
@@ -1,4 +1,8 @@
-﻿#include <iostream>
+﻿#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
@@ -10,12 +14,95 @@
 #include "HEVCAnalyzerFFmpeg.hpp"
 #include "ColorConversion.hpp"
 #include "VideoConverter.hpp"
+#include "ThumbnailExtractor.hpp"
+#include "ConverterDaemon.hpp"
 
 
 void print_usage() {
 	std::cout << "Usage: program -i <movie_file> -image <image_file> -o <output_file> [-convert] [-analzye--binary] [-analyze--ffmpeg]" << std::endl;
+	std::cout << "Scaling options for -convert: [-size <WxH>] [-pix_fmt <format>] [-fps <rate>] [-scale-threads <n>]" << std::endl;
+	std::cout << "ABR ladder for -convert: [-ladder <size>[,<size>...]] e.g. 2160p,1080p,720p,480p (one output per size)" << std::endl;
+	std::cout << "SPS parser throughput on the -o file: [-bench--sps]" << std::endl;
+	std::cout << "RGB to YUV kernel throughput: [-bench--color <image_file>]" << std::endl;
+	std::cout << "Thumbnails of the -i file named after -o: [-thumbnails <count>] [-thumb-width <px>] [-thumb-threads <n>] [-thumb-exact]" << std::endl;
+	std::cout << "Inline PSNR/SSIM for -convert: [-quality] [-quality-threads <n>] (per frame in <output>.quality.log)" << std::endl;
+	std::cout << "Resumable -convert: [-checkpoint <seconds>] (rerun the same command to resume an interrupted job)" << std::endl;
+	std::cout << "Resident mode: -daemon <socket> [-daemon-workers <n>], then -submit <socket> <json_request> per job" << std::endl;
 }
 
+// Whole-string integer of at least minimum; reports the option on failure.
+bool parse_int(const std::string& option, const std::string& text, int minimum, int& value) {
+	char* end = nullptr;
+	errno = 0;
+	long parsed = std::strtol(text.c_str(), &end, 10);
+	if (text.empty() || *end != '\0' || errno == ERANGE || parsed < minimum || parsed > INT_MAX) {
+		std::cerr << "Invalid value for " << option << ": " << text << std::endl;
+		return false;
+	}
+	value = static_cast<int>(parsed);
+	return true;
+}
+
+// Parses the SPS of the file's extradata over and over from memory and reports SPS per second.
+int benchmark_sps(const std::string& filename) {
+	AVFormatContext* formatContext = nullptr;
+	if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0 ||
+		avformat_find_stream_info(formatContext, nullptr) < 0) {
+		std::cerr << "Could not open " << filename << std::endl;
+		avformat_close_input(&formatContext);
+		return 1;
+	}
+
+	int streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if (streamIndex < 0) {
+		std::cerr << "Could not find video stream in " << filename << std::endl;
+		avformat_close_input(&formatContext);
+		return 1;
+	}
+	const AVCodecParameters* codecpar = formatContext->streams[streamIndex]->codecpar;
+	std::span<const uint8_t> extradata(codecpar->extradata, static_cast<size_t>(codecpar->extradata_size));
+
+	constexpr int iterations = 1000000;
+	int parsed = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		parsed += HEVCParser::parseExtradata(extradata).has_value();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	avformat_close_input(&formatContext);
+
+	if (parsed != iterations) {
+		std::cerr << "SPS could not be parsed: " << toString(HEVCParser::parseExtradata(extradata).error()) << std::endl;
+		return 1;
+	}
+	std::cout << "Parsed " << iterations << " SPS in " << elapsed.count() << " s: "
+		<< static_cast<int64_t>(iterations / elapsed.count()) << " SPS/s" << std::endl;
+	return 0;
+}
+
+// Converts the image over and over and reports megapixels per second for the dispatched kernels.
+int benchmark_color(const std::string& filename) {
+	cv::Mat rgbImage = cv::imread(filename);
+	if (rgbImage.empty()) {
+		std::cerr << "Could not open or find the image!\n";
+		return 1;
+	}
+
+	constexpr int iterations = 200;
+	cv::Mat yuvImage;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		// quiet, so reporting the image size stays out of the timing
+		ColorConversion::convertRGBtoYUV_JPEG(rgbImage, yuvImage, false);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	double megapixels = static_cast<double>(rgbImage.rows) * rgbImage.cols * iterations / 1e6;
+	std::cout << "Converted " << iterations << " x " << rgbImage.cols << "x" << rgbImage.rows << " with "
+		<< ColorConversion::kernelName() << " kernels in " << elapsed.count() << " s: "
+		<< megapixels / elapsed.count() << " Mpixel/s" << std::endl;
+	return 0;
+}
 
 int main(int argc, char* argv[]) {
 
@@ -25,8 +112,21 @@ int main(int argc, char* argv[]) {
 	std::string fileOutput;
 	bool useVideoConverter = false;
 	bool useHEVCParser = false;
+	bool useSpsBenchmark = false;
+	std::string colorBenchmarkImage;
 	bool useHEVCAnalyzerFFmpeg = false;
 	bool useRGB_YUVConversion = false;
+	ScalingOptions scalingOptions;
+	std::string ladder;
+	int checkpointInterval = 0;
+	bool useQualityMetrics = false;
+	int qualityThreads = 0;
+	bool useThumbnailExtractor = false;
+	ThumbnailOptions thumbnailOptions;
+	std::string daemonSocket;
+	int daemonWorkers = ConverterDaemon::defaultWorkers;
+	std::string submitSocket;
+	std::string submitRequest;
 
 
 	std::vector<std::string> args(argv, argv + argc);
@@ -50,15 +150,102 @@ int main(int argc, char* argv[]) {
 		else if (args[i] == "-analzye--binary") {
 			useHEVCParser = true;
 		}
+		else if (args[i] == "-bench--sps") {
+			useSpsBenchmark = true;
+		}
+		else if (args[i] == "-bench--color" && i + 1 < args.size()) {
+			colorBenchmarkImage = args[++i];
+		}
 		else if (args[i] == "-analyze--ffmpeg") {
 			useHEVCAnalyzerFFmpeg = true;
 		}
+		else if (args[i] == "-size" && i + 1 < args.size()) {
+			if (av_parse_video_size(&scalingOptions.width, &scalingOptions.height, args[++i].c_str()) < 0) {
+				std::cerr << "Invalid size: " << args[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (args[i] == "-pix_fmt" && i + 1 < args.size()) {
+			scalingOptions.pixelFormat = av_get_pix_fmt(args[++i].c_str());
+			if (scalingOptions.pixelFormat == AV_PIX_FMT_NONE) {
+				std::cerr << "Invalid pixel format: " << args[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (args[i] == "-fps" && i + 1 < args.size()) {
+			if (av_parse_video_rate(&scalingOptions.frameRate, args[++i].c_str()) < 0) {
+				std::cerr << "Invalid frame rate: " << args[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (args[i] == "-scale-threads" && i + 1 < args.size()) {
+			if (!parse_int("-scale-threads", args[++i], 0, scalingOptions.threads)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-ladder" && i + 1 < args.size()) {
+			ladder = args[++i];
+		}
+		else if (args[i] == "-checkpoint" && i + 1 < args.size()) {
+			if (!parse_int("-checkpoint", args[++i], 0, checkpointInterval)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-quality") {
+			useQualityMetrics = true;
+		}
+		else if (args[i] == "-quality-threads" && i + 1 < args.size()) {
+			if (!parse_int("-quality-threads", args[++i], 0, qualityThreads)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-thumbnails" && i + 1 < args.size()) {
+			if (!parse_int("-thumbnails", args[++i], 1, thumbnailOptions.count)) {
+				return 1;
+			}
+			useThumbnailExtractor = true;
+		}
+		else if (args[i] == "-thumb-width" && i + 1 < args.size()) {
+			if (!parse_int("-thumb-width", args[++i], 0, thumbnailOptions.width)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-thumb-threads" && i + 1 < args.size()) {
+			if (!parse_int("-thumb-threads", args[++i], 0, thumbnailOptions.threads)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-thumb-exact") {
+			thumbnailOptions.exact = true;
+		}
+		else if (args[i] == "-daemon" && i + 1 < args.size()) {
+			daemonSocket = args[++i];
+		}
+		else if (args[i] == "-daemon-workers" && i + 1 < args.size()) {
+			if (!parse_int("-daemon-workers", args[++i], 1, daemonWorkers)) {
+				return 1;
+			}
+		}
+		else if (args[i] == "-submit" && i + 2 < args.size()) {
+			submitSocket = args[++i];
+			submitRequest = args[++i];
+		}
 		else {
 			print_usage();
 			return 1;
 		}
 	}
 
+	if (!daemonSocket.empty()) {
+		// keep workers and their converters warm, take jobs over the socket until SIGINT/SIGTERM
+		ConverterDaemon daemon(daemonSocket, daemonWorkers);
+		return daemon.run() ? 0 : 1;
+	}
+
+	if (!submitSocket.empty()) {
+		return ConverterDaemon::submit(submitSocket, submitRequest) ? 0 : 1;
+	}
+
 	if (filenameMovie.empty()) {
 		std::cerr << "Movie file must be specified with -i" << std::endl;
 		return 1;
@@ -74,22 +261,61 @@ int main(int argc, char* argv[]) {
 		/* non HEVC data stream to HEVC data stream */
 
 		// convert non hevc video stream to hevc video stream
-		VideoConverter converter(filenameMovie, fileOutput);
-		converter.convertToHEVC();
+		if (ladder.empty()) {
+			VideoConverter converter(filenameMovie, fileOutput, scalingOptions);
+			converter.setCheckpointInterval(checkpointInterval);
+			converter.setQualityMetrics(useQualityMetrics, qualityThreads);
+			if (!converter.convertToHEVC()) {
+				std::cerr << "Conversion failed" << std::endl;
+				return 1;
+			}
+		}
+		else {
+			// decode once, encode every rendition of the ladder in parallel
+			std::vector<Rendition> renditions;
+			if (!parseLadder(ladder, fileOutput, scalingOptions, renditions)) {
+				return 1;
+			}
+			VideoConverter converter(filenameMovie, renditions);
+			converter.setCheckpointInterval(checkpointInterval);
+			converter.setQualityMetrics(useQualityMetrics, qualityThreads);
+			if (!converter.convertToHEVC()) {
+				std::cerr << "Conversion failed" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	if (useThumbnailExtractor) {
+		// seek to keyframes from the demuxer index and decode only those frames
+		ThumbnailExtractor extractor(filenameMovie, fileOutput, thumbnailOptions);
+		bool extracted = extractor.extract();
+		for (const Thumbnail& thumbnail : extractor.thumbnails()) {
+			std::cout << thumbnail.filename << " @ " << thumbnail.time << " s" << std::endl;
+		}
+		if (!extracted) {
+			return 1;
+		}
 	}
 
 	if (useHEVCParser) {
 		// extract information from HEVC reading NAL structure with binary reading and also with the help of ffmpeg
-		try {
-			HEVCParser parser(fileOutput);
-			HEVCInfo info = parser.parse();
-		}
-		catch (const std::exception& ex) {
-			std::cerr << "Error: " << ex.what() << std::endl;
+		HEVCParser parser(fileOutput);
+		HEVCResult<HEVCInfo> info = parser.parse();
+		if (!info) {
+			std::cerr << "Error: " << toString(info.error()) << std::endl;
 			return 1;
 		}
 	}
 
+	if (useSpsBenchmark && benchmark_sps(fileOutput) != 0) {
+		return 1;
+	}
+
+	if (!colorBenchmarkImage.empty() && benchmark_color(colorBenchmarkImage) != 0) {
+		return 1;
+	}
+
 	if (useHEVCAnalyzerFFmpeg) {
 		HEVCAnalyzerFFmpeg ffmpegAnalyzer;
 		ffmpegAnalyzer.analyze(fileOutput.c_str());
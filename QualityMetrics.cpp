@@ -0,0 +1,297 @@
+#include "QualityMetrics.hpp"
+#include "QualityMetricsKernels.hpp"
+#include "CpuFeatures.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+namespace {
+
+// Picked once, on first use, from the kernels this binary was built with.
+const QualityMetricsKernels& kernels() {
+    static const QualityMetricsKernels& selected = [] () -> const QualityMetricsKernels& {
+        const QualityMetricsKernels* avx2 = avx2QualityMetricsKernels();
+        if (avx2 && cpuSupportsAVX2()) {
+            return *avx2;
+        }
+        return scalarQualityMetricsKernels();
+    }();
+    return selected;
+}
+
+double psnr(uint64_t sse, uint64_t samples, int maxValue) {
+    if (sse == 0 || samples == 0) {
+        return INFINITY;
+    }
+    return 10.0 * std::log10(static_cast<double>(maxValue) * maxValue * static_cast<double>(samples) / static_cast<double>(sse));
+}
+
+} // namespace
+
+QualityMeter::QualityMeter(int threads) {
+    threadCount = threads > 0 ? threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    // The thread calling measure() works on a band too.
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&QualityMeter::workerLoop, this);
+    }
+}
+
+QualityMeter::~QualityMeter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobsReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+bool QualityMeter::supports(AVPixelFormat format) {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(format);
+    if (!descriptor || (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_PAL |
+                                             AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_FLOAT | AV_PIX_FMT_FLAG_BE))) {
+        return false;
+    }
+    if (!(descriptor->flags & AV_PIX_FMT_FLAG_PLANAR) && descriptor->nb_components != 1) {
+        return false;
+    }
+
+    // One component per plane, stored in whole bytes (rules out NV12 and friends).
+    int depth = descriptor->comp[0].depth;
+    if (depth < 8 || depth > 16 || av_pix_fmt_count_planes(format) != descriptor->nb_components) {
+        return false;
+    }
+    for (int i = 0; i < descriptor->nb_components; ++i) {
+        const AVComponentDescriptor& component = descriptor->comp[i];
+        if (component.depth != depth || component.shift != 0 || component.step != (depth > 8 ? 2 : 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* QualityMeter::kernelName() {
+    return kernels().isa;
+}
+
+bool QualityMeter::measure(const AVFrame* reference, const AVFrame* reconstructed, FrameQuality& quality) {
+    AVPixelFormat pixelFormat = static_cast<AVPixelFormat>(reference->format);
+    if (reference->width != reconstructed->width || reference->height != reconstructed->height ||
+        reference->format != reconstructed->format) {
+        std::cerr << "Cannot compare frames of different size or format." << std::endl;
+        return false;
+    }
+    if (!supports(pixelFormat)) {
+        std::cerr << "Quality metrics do not support pixel format " << av_get_pix_fmt_name(pixelFormat) << std::endl;
+        return false;
+    }
+
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(pixelFormat);
+    int planeCount = av_pix_fmt_count_planes(pixelFormat);
+    int depth = descriptor->comp[0].depth;
+    bool wide = depth > 8;
+    int planeMax = (1 << depth) - 1;
+
+    int widths[4] = {};
+    int heights[4] = {};
+    size_t scratchSize = 0;
+    std::vector<Job> jobs;
+    for (int plane = 0; plane < planeCount; ++plane) {
+        bool chroma = plane == 1 || plane == 2;
+        widths[plane] = chroma ? AV_CEIL_RSHIFT(reference->width, descriptor->log2_chroma_w) : reference->width;
+        heights[plane] = chroma ? AV_CEIL_RSHIFT(reference->height, descriptor->log2_chroma_h) : reference->height;
+
+        // One band of rows (and of SSIM window rows) per thread.
+        int windowRows = FFMAX(0, heights[plane] / 4 - 1);
+        int rowsPerBand = (heights[plane] + threadCount - 1) / threadCount;
+        int windowRowsPerBand = (windowRows + threadCount - 1) / threadCount;
+        for (int first = 0; first < heights[plane]; first += rowsPerBand) {
+            jobs.push_back({ plane, false, first, FFMIN(rowsPerBand, heights[plane] - first) });
+        }
+        if (widths[plane] >= 8) {
+            for (int first = 0; first < windowRows; first += windowRowsPerBand) {
+                jobs.push_back({ plane, true, first, FFMIN(windowRowsPerBand, windowRows - first), scratchSize });
+                scratchSize += ssimScratchSize(widths[plane]);
+            }
+        }
+    }
+
+    // Every SSIM band gets its own slice of the scratch the kernels work in.
+    if (wide) {
+        scratch16.resize(FFMAX(scratch16.size(), scratchSize));
+    }
+    else {
+        scratch8.resize(FFMAX(scratch8.size(), scratchSize));
+    }
+
+    const QualityMetricsKernels& kernel = kernels();
+    std::vector<uint64_t> sse(jobs.size(), 0);
+    std::vector<double> ssim(jobs.size(), 0);
+    parallelFor(static_cast<int>(jobs.size()), [&](int index) {
+        const Job& job = jobs[index];
+        const uint8_t* a = reference->data[job.plane];
+        const uint8_t* b = reconstructed->data[job.plane];
+        ptrdiff_t strideA = reference->linesize[job.plane];
+        ptrdiff_t strideB = reconstructed->linesize[job.plane];
+        int width = widths[job.plane];
+        if (job.ssim) {
+            ssim[index] = wide
+                ? kernel.ssim16(a, strideA, b, strideB, width, job.first, job.count, planeMax, scratch16.data() + job.scratchOffset)
+                : kernel.ssim8(a, strideA, b, strideB, width, job.first, job.count, planeMax, scratch8.data() + job.scratchOffset);
+        }
+        else {
+            sse[index] = (wide ? kernel.sse16 : kernel.sse8)(a, strideA, b, strideB, width, job.first, job.count);
+        }
+    });
+
+    uint64_t planeSse[4] = {};
+    double planeSsim[4] = {};
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        planeSse[jobs[i].plane] += sse[i];
+        planeSsim[jobs[i].plane] += ssim[i];
+    }
+
+    quality.pts = reference->pts;
+    quality.planes = planeCount;
+    uint64_t sseAll = 0;
+    uint64_t samplesAll = 0;
+    double ssimAll = 0;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int plane = 0; plane < planeCount; ++plane) {
+        uint64_t samples = static_cast<uint64_t>(widths[plane]) * heights[plane];
+        int64_t windows = static_cast<int64_t>(FFMAX(0, widths[plane] / 4 - 1)) * FFMAX(0, heights[plane] / 4 - 1);
+        quality.plane[plane].psnr = psnr(planeSse[plane], samples, planeMax);
+        quality.plane[plane].ssim = windows > 0 ? planeSsim[plane] / windows : 1.0;
+
+        sseAll += planeSse[plane];
+        samplesAll += samples;
+        ssimAll += quality.plane[plane].ssim * samples;
+
+        totalSse[plane] += planeSse[plane];
+        totalSamples[plane] += samples;
+        totalSsim[plane] += quality.plane[plane].ssim;
+    }
+    quality.all.psnr = psnr(sseAll, samplesAll, planeMax);
+    quality.all.ssim = ssimAll / samplesAll;
+
+    totalSsimAll += quality.all.ssim;
+    planes = planeCount;
+    maxValue = planeMax;
+    ++frames;
+    return true;
+}
+
+QualitySummary QualityMeter::summary() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    QualitySummary result;
+    result.frames = frames;
+    result.planes = planes;
+    if (frames == 0) {
+        return result;
+    }
+
+    uint64_t sseAll = 0;
+    uint64_t samplesAll = 0;
+    for (int plane = 0; plane < planes; ++plane) {
+        result.plane[plane].psnr = psnr(totalSse[plane], totalSamples[plane], maxValue);
+        result.plane[plane].ssim = totalSsim[plane] / frames;
+        sseAll += totalSse[plane];
+        samplesAll += totalSamples[plane];
+    }
+    result.all.psnr = psnr(sseAll, samplesAll, maxValue);
+    result.all.ssim = totalSsimAll / frames;
+    return result;
+}
+
+const char* QualityMeter::planeName(AVPixelFormat pixelFormat, int plane) {
+    const AVPixFmtDescriptor* descriptor = av_pix_fmt_desc_get(pixelFormat);
+    static const char* const yuvNames[4] = { "y", "u", "v", "a" };
+    static const char* const grayNames[4] = { "y", "a", "", "" };
+    const char* const* names = descriptor && descriptor->nb_components <= 2 ? grayNames : yuvNames;
+    return plane >= 0 && plane < 4 ? names[plane] : "";
+}
+
+std::string QualityMeter::format(const PlaneQuality* planeQuality, int planeCount, const PlaneQuality& all, AVPixelFormat pixelFormat) {
+    std::string text;
+    char value[64];
+    for (int plane = 0; plane < planeCount; ++plane) {
+        std::snprintf(value, sizeof(value), "psnr_%s:%.2f ", planeName(pixelFormat, plane), planeQuality[plane].psnr);
+        text += value;
+    }
+    std::snprintf(value, sizeof(value), "psnr_all:%.2f", all.psnr);
+    text += value;
+    for (int plane = 0; plane < planeCount; ++plane) {
+        std::snprintf(value, sizeof(value), " ssim_%s:%.6f", planeName(pixelFormat, plane), planeQuality[plane].ssim);
+        text += value;
+    }
+    std::snprintf(value, sizeof(value), " ssim_all:%.6f", all.ssim);
+    text += value;
+    return text;
+}
+
+// Runs function(0 .. count - 1) on the workers and the calling thread and returns when all
+// calls are done.
+void QualityMeter::parallelFor(int count, const std::function<void(int)>& function) {
+    if (workers.empty()) {
+        for (int i = 0; i < count; ++i) {
+            function(i);
+        }
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    task = &function;
+    taskCount = count;
+    nextTask = 0;
+    remainingTasks = count;
+    ++generation;
+    lock.unlock();
+    jobsReady.notify_all();
+
+    runTasks();
+
+    lock.lock();
+    jobsDone.wait(lock, [this] { return remainingTasks == 0; });
+    task = nullptr;
+}
+
+void QualityMeter::runTasks() {
+    while (true) {
+        const std::function<void(int)>* function = nullptr;
+        int index = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!task || nextTask >= taskCount) {
+                return;
+            }
+            function = task;
+            index = nextTask++;
+        }
+
+        (*function)(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remainingTasks == 0) {
+            jobsDone.notify_all();
+        }
+    }
+}
+
+void QualityMeter::workerLoop() {
+    uint64_t seenGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobsReady.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+        runTasks();
+    }
+}
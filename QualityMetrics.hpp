@@ -0,0 +1,102 @@
+#ifndef QUALITYMETRICS_H
+#define QUALITYMETRICS_H
+
+extern "C"
+{
+    #include <libavutil/frame.h>
+    #include <libavutil/pixdesc.h>
+}
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct PlaneQuality {
+    double psnr = 0;  // dB, infinite when the planes are identical
+    double ssim = 0;
+};
+
+struct FrameQuality {
+    int64_t pts = 0;
+    int planes = 0;
+    PlaneQuality plane[4];
+    PlaneQuality all;  // every plane, weighted by its number of samples
+};
+
+// Run totals: PSNR from the summed squared error of all frames, SSIM averaged over frames.
+struct QualitySummary {
+    int64_t frames = 0;
+    int planes = 0;
+    PlaneQuality plane[4];
+    PlaneQuality all;
+};
+
+// Per-plane PSNR and SSIM between reference frames and their reconstruction, computed the
+// same way as FFmpeg's psnr/ssim filters. Every plane is split into row bands that run on
+// the meter's threads through the per-ISA kernels.
+class QualityMeter {
+public:
+    // threads: total threads used per frame, including the caller; 0 = one per core.
+    explicit QualityMeter(int threads = 0);
+    ~QualityMeter();
+
+    QualityMeter(const QualityMeter&) = delete;
+    QualityMeter& operator=(const QualityMeter&) = delete;
+
+    // Planar YUV or gray with 8 to 16 bits per sample.
+    static bool supports(AVPixelFormat format);
+    // Instruction set of the kernels selected at runtime, e.g. "avx2".
+    static const char* kernelName();
+
+    // Both frames must have the same size and a supported pixel format. The result is also
+    // added to the summary.
+    bool measure(const AVFrame* reference, const AVFrame* reconstructed, FrameQuality& quality);
+    QualitySummary summary() const;
+
+    // "y", "u", "v" or "a" for the planes of pixelFormat.
+    static const char* planeName(AVPixelFormat pixelFormat, int plane);
+    // "psnr_y:41.20 psnr_u:45.03 ... ssim_all:0.981" for a log line or report.
+    static std::string format(const PlaneQuality* planes, int planeCount, const PlaneQuality& all, AVPixelFormat pixelFormat);
+
+private:
+    struct Job {
+        int plane;
+        bool ssim;
+        int first;
+        int count;
+        size_t scratchOffset = 0;
+    };
+
+    int threadCount;
+    int64_t frames = 0;
+    int planes = 0;
+    int maxValue = 0;
+    uint64_t totalSse[4] = {};
+    uint64_t totalSamples[4] = {};
+    double totalSsim[4] = {};
+    double totalSsimAll = 0;
+    // SSIM kernel scratch, reused from frame to frame (measure() has a single caller at a time).
+    std::vector<uint32_t> scratch8;
+    std::vector<uint64_t> scratch16;
+
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobsReady;
+    std::condition_variable jobsDone;
+    const std::function<void(int)>* task = nullptr;
+    int taskCount = 0;
+    int nextTask = 0;
+    int remainingTasks = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void parallelFor(int count, const std::function<void(int)>& function);
+    void runTasks();
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,39 @@
+#include "QualityMetricsKernels.hpp"
+
+// Built with AVX2 enabled (-mavx2 / /arch:AVX2) so the compiler vectorises the shared
+// plane templates for it.
+
+#if defined(__AVX2__)
+
+namespace {
+
+uint64_t sse8(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstRow, int rows) {
+    return planeSse<uint8_t, uint32_t>(a, strideA, b, strideB, width, firstRow, rows);
+}
+
+uint64_t sse16(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstRow, int rows) {
+    return planeSse<uint16_t, uint64_t>(a, strideA, b, strideB, width, firstRow, rows);
+}
+
+double ssim8(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstWindowRow, int windowRows, int maxValue, uint32_t* scratch) {
+    return planeSsim<uint8_t, uint32_t>(a, strideA, b, strideB, width, firstWindowRow, windowRows, maxValue, scratch);
+}
+
+double ssim16(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstWindowRow, int windowRows, int maxValue, uint64_t* scratch) {
+    return planeSsim<uint16_t, uint64_t>(a, strideA, b, strideB, width, firstWindowRow, windowRows, maxValue, scratch);
+}
+
+} // namespace
+
+const QualityMetricsKernels* avx2QualityMetricsKernels() {
+    static const QualityMetricsKernels kernels = { "avx2", sse8, sse16, ssim8, ssim16 };
+    return &kernels;
+}
+
+#else
+
+const QualityMetricsKernels* avx2QualityMetricsKernels() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef QUALITYMETRICSKERNELS_H
+#define QUALITYMETRICSKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Plane kernels behind QualityMeter, compiled once per instruction set like the colour
+// conversion kernels (QualityMetricsScalar.cpp, QualityMetricsAVX2.cpp). Each call covers a
+// band of rows so QualityMeter can spread a plane over its threads. Strides are in bytes;
+// the 16-bit variants take native-endian samples of up to 16 bits.
+struct QualityMetricsKernels {
+    const char* isa;
+    // Sum of squared differences over rows [firstRow, firstRow + rows).
+    uint64_t (*sse8)(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstRow, int rows);
+    uint64_t (*sse16)(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstRow, int rows);
+    // Sum of the SSIM of the 8x8 windows, stepped by 4, whose top row is 4 * [firstWindowRow,
+    // firstWindowRow + windowRows). A plane has (width / 4 - 1) * (height / 4 - 1) windows.
+    // scratch holds ssimScratchSize(width) elements owned by the caller.
+    double (*ssim8)(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstWindowRow, int windowRows, int maxValue, uint32_t* scratch);
+    double (*ssim16)(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstWindowRow, int windowRows, int maxValue, uint64_t* scratch);
+};
+
+const QualityMetricsKernels& scalarQualityMetricsKernels();
+// nullptr when the translation unit was not compiled with AVX2 enabled.
+const QualityMetricsKernels* avx2QualityMetricsKernels();
+
+// Internal linkage so every ISA translation unit keeps its own instantiations. That only
+// holds for code defined here: std templates (containers, std::swap, ...) have external
+// linkage, and the linker may keep an AVX2-compiled copy for the whole program, so they
+// must not be used below. Memory comes from the caller instead.
+namespace {
+
+// Elements of scratch a planeSsim() call needs for a plane width samples wide.
+inline size_t ssimScratchSize(int width) {
+    return 4 * (static_cast<size_t>(width) + 2 * static_cast<size_t>(width / 4));
+}
+
+template <typename T>
+inline const T* qualityRow(const uint8_t* plane, ptrdiff_t stride, int row) {
+    return reinterpret_cast<const T*>(plane + stride * row);
+}
+
+// Per-row sums stay in Acc (no overflow for any row width a video can have) and are
+// collected in 64 bits.
+template <typename T, typename Acc>
+uint64_t planeSse(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int firstRow, int rows) {
+    uint64_t sum = 0;
+    for (int y = firstRow; y < firstRow + rows; ++y) {
+        const T* rowA = qualityRow<T>(a, strideA, y);
+        const T* rowB = qualityRow<T>(b, strideB, y);
+        Acc rowSum = 0;
+        for (int x = 0; x < width; ++x) {
+            Acc difference = static_cast<Acc>(rowA[x] > rowB[x] ? rowA[x] - rowB[x] : rowB[x] - rowA[x]);
+            rowSum += difference * difference;
+        }
+        sum += rowSum;
+    }
+    return sum;
+}
+
+// Four arrays of per-column or per-block sums in caller-owned memory.
+template <typename Acc>
+struct SsimBlockSums {
+    Acc* sumA;
+    Acc* sumB;
+    Acc* sumSquares;
+    Acc* sumProducts;
+
+    // Lays the arrays out one after another from memory, count entries each.
+    static SsimBlockSums over(Acc* memory, int count) {
+        return { memory, memory + count, memory + 2 * count, memory + 3 * count };
+    }
+
+    void clear(int count) {
+        for (int i = 0; i < count; ++i) {
+            sumA[i] = 0;
+            sumB[i] = 0;
+            sumSquares[i] = 0;
+            sumProducts[i] = 0;
+        }
+    }
+};
+
+// Sums of the 4x4 blocks in block row blockRow. Columns are summed first so the inner loop
+// runs over contiguous samples and vectorises; then every four columns form a block.
+template <typename T, typename Acc>
+void ssimBlockRow(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width, int blockRow,
+                  SsimBlockSums<Acc>& columns, SsimBlockSums<Acc>& blocks) {
+    columns.clear(width);
+    for (int y = blockRow * 4; y < blockRow * 4 + 4; ++y) {
+        const T* rowA = qualityRow<T>(a, strideA, y);
+        const T* rowB = qualityRow<T>(b, strideB, y);
+        for (int x = 0; x < width; ++x) {
+            Acc sampleA = rowA[x];
+            Acc sampleB = rowB[x];
+            columns.sumA[x] += sampleA;
+            columns.sumB[x] += sampleB;
+            columns.sumSquares[x] += sampleA * sampleA + sampleB * sampleB;
+            columns.sumProducts[x] += sampleA * sampleB;
+        }
+    }
+
+    int blockCount = width / 4;
+    blocks.clear(blockCount);
+    for (int block = 0; block < blockCount; ++block) {
+        for (int x = block * 4; x < block * 4 + 4; ++x) {
+            blocks.sumA[block] += columns.sumA[x];
+            blocks.sumB[block] += columns.sumB[x];
+            blocks.sumSquares[block] += columns.sumSquares[x];
+            blocks.sumProducts[block] += columns.sumProducts[x];
+        }
+    }
+}
+
+// SSIM of one 8x8 window from its sums, with the constants and the 64/63 variance
+// correction of x264 and FFmpeg's ssim filter so the numbers are comparable.
+inline double ssimWindow(double sumA, double sumB, double sumSquares, double sumProducts, int maxValue) {
+    double c1 = .01 * .01 * maxValue * maxValue * 64;
+    double c2 = .03 * .03 * maxValue * maxValue * 64 * 63;
+    double variances = sumSquares * 64 - sumA * sumA - sumB * sumB;
+    double covariance = sumProducts * 64 - sumA * sumB;
+    return (2 * sumA * sumB + c1) * (2 * covariance + c2) /
+           ((sumA * sumA + sumB * sumB + c1) * (variances + c2));
+}
+
+template <typename T, typename Acc>
+double planeSsim(const uint8_t* a, ptrdiff_t strideA, const uint8_t* b, ptrdiff_t strideB, int width,
+                 int firstWindowRow, int windowRows, int maxValue, Acc* scratch) {
+    int blockCount = width / 4;
+    SsimBlockSums<Acc> columns = SsimBlockSums<Acc>::over(scratch, width);
+    SsimBlockSums<Acc> top = SsimBlockSums<Acc>::over(scratch + 4 * static_cast<size_t>(width), blockCount);
+    SsimBlockSums<Acc> bottom = SsimBlockSums<Acc>::over(scratch + 4 * (static_cast<size_t>(width) + blockCount), blockCount);
+    int windows = blockCount - 1;
+
+    double sum = 0;
+    ssimBlockRow<T, Acc>(a, strideA, b, strideB, width, firstWindowRow, columns, top);
+    for (int windowRow = firstWindowRow; windowRow < firstWindowRow + windowRows; ++windowRow) {
+        ssimBlockRow<T, Acc>(a, strideA, b, strideB, width, windowRow + 1, columns, bottom);
+        for (int x = 0; x < windows; ++x) {
+            sum += ssimWindow(
+                static_cast<double>(top.sumA[x]) + top.sumA[x + 1] + bottom.sumA[x] + bottom.sumA[x + 1],
+                static_cast<double>(top.sumB[x]) + top.sumB[x + 1] + bottom.sumB[x] + bottom.sumB[x + 1],
+                static_cast<double>(top.sumSquares[x]) + top.sumSquares[x + 1] + bottom.sumSquares[x] + bottom.sumSquares[x + 1],
+                static_cast<double>(top.sumProducts[x]) + top.sumProducts[x + 1] + bottom.sumProducts[x] + bottom.sumProducts[x + 1],
+                maxValue);
+        }
+        SsimBlockSums<Acc> previous = top;
+        top = bottom;
+        bottom = previous;
+    }
+    return sum;
+}
+
+} // namespace
+
+#endif // QUALITYMETRICSKERNELS_H
@@ -0,0 +1,706 @@
+#include "RenditionOutput.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+bool parseLadder(const std::string& ladder, const std::string& outputFile, const ScalingOptions& base, std::vector<Rendition>& renditions) {
+    // A dot only starts the extension within the file name, not in a directory name.
+    size_t slash = outputFile.find_last_of("/\\");
+    size_t dot = outputFile.find_last_of('.');
+    if (slash != std::string::npos && dot != std::string::npos && dot < slash) {
+        dot = std::string::npos;
+    }
+    std::string stem = dot == std::string::npos ? outputFile : outputFile.substr(0, dot);
+    std::string extension = dot == std::string::npos ? "" : outputFile.substr(dot);
+
+    size_t start = 0;
+    while (start <= ladder.size()) {
+        size_t comma = ladder.find(',', start);
+        std::string size = ladder.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+        start = comma == std::string::npos ? ladder.size() + 1 : comma + 1;
+
+        Rendition rendition{ stem + "_" + size + extension, base };
+        if (size.size() > 1 && size.back() == 'p' && size.find_first_not_of("0123456789") == size.size() - 1) {
+            long height = std::strtol(size.c_str(), nullptr, 10);
+            if (height <= 0 || height > 16384) {
+                std::cerr << "Invalid ladder size: " << size << std::endl;
+                return false;
+            }
+            rendition.scaling.width = 0;
+            rendition.scaling.height = static_cast<int>(height);
+        }
+        else if (av_parse_video_size(&rendition.scaling.width, &rendition.scaling.height, size.c_str()) < 0) {
+            std::cerr << "Invalid ladder size: " << size << std::endl;
+            return false;
+        }
+        renditions.push_back(rendition);
+    }
+    return true;
+}
+
+RenditionOutput::~RenditionOutput() {
+    finish();
+    wait();
+    cleanup();
+}
+
+int64_t RenditionOutput::resumeTime() const {
+    if (!resuming) {
+        return 0;
+    }
+    if (encodingComplete) {
+        return INT64_MAX;
+    }
+    return av_rescale_q(checkpoint.videoResumePts, checkpoint.videoTimeBase, av_make_q(1, AV_TIME_BASE));
+}
+
+// Segments are MP4 regardless of the final container: a completed segment is playable on
+// its own, and MP4 keeps the encoder time bases and the encoder's DTS, so joining them
+// gets back the exact timestamps. Matroska would round both streams to milliseconds.
+std::string RenditionOutput::segmentFilename(int index) const {
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".part%04d.mp4", index);
+    return outputFilename + suffix;
+}
+
+// Allocates the output format context for currentFilename with the encoded video stream
+// and the shared audio stream.
+bool RenditionOutput::createOutputContext() {
+    avformat_alloc_output_context2(&outputFormatContext, nullptr, nullptr, currentFilename.c_str());
+    if (!outputFormatContext) {
+        std::cerr << "Could not create output context for " << currentFilename << std::endl;
+        return false;
+    }
+
+    outputVideoStream = avformat_new_stream(outputFormatContext, nullptr);
+    if (!outputVideoStream || avcodec_parameters_from_context(outputVideoStream->codecpar, videoEncoderContext) < 0) {
+        std::cerr << "Failed to allocate video output stream." << std::endl;
+        return false;
+    }
+    outputVideoStream->time_base = videoEncoderContext->time_base;
+
+    outputAudioStream = avformat_new_stream(outputFormatContext, nullptr);
+    if (!outputAudioStream || avcodec_parameters_copy(outputAudioStream->codecpar, audioParameters) < 0) {
+        std::cerr << "Failed to allocate audio output stream." << std::endl;
+        return false;
+    }
+    outputAudioStream->time_base = audioTimeBase;
+
+    return true;
+}
+
+// Loads the checkpoint, if any. The output context is only created once the checkpoint
+// has been checked against the encoders, in initializeAudioStream().
+bool RenditionOutput::initializeOutputFile() {
+    currentFilename = outputFilename;
+    if (checkpointInterval > 0) {
+        resuming = checkpoint.load(checkpointFilename());
+        currentFilename = segmentFilename(checkpoint.segments());
+    }
+    return true;
+}
+
+bool RenditionOutput::needsGlobalHeader() const {
+    const AVOutputFormat* format = av_guess_format(nullptr, currentFilename.c_str(), nullptr);
+    if (format && (format->flags & AVFMT_GLOBALHEADER)) {
+        return true;
+    }
+    // Segments are remuxed into the real output at the end, which may need them too.
+    const AVOutputFormat* finalFormat = checkpointInterval > 0 ? av_guess_format(nullptr, outputFilename.c_str(), nullptr) : nullptr;
+    return finalFormat && (finalFormat->flags & AVFMT_GLOBALHEADER);
+}
+
+// Configures the scaler from the decoder and opens an HEVC encoder matching its output.
+bool RenditionOutput::initializeVideoEncoder(AVFormatContext* inputFormatContext, AVStream* videoStream, const AVCodecContext* videoDecoderContext) {
+    const AVCodec* videoEncoder = avcodec_find_encoder(AV_CODEC_ID_HEVC);
+    if (!videoEncoder) {
+        std::cerr << "Necessary video encoder not found." << std::endl;
+        return false;
+    }
+
+    // The scaling stage decides the encoded geometry, pixel format and frame rate.
+    if (!scaler.configure(videoDecoderContext, av_guess_frame_rate(inputFormatContext, videoStream, nullptr), videoStream->time_base)) {
+        return false;
+    }
+
+    videoEncoderContext = avcodec_alloc_context3(videoEncoder);
+    videoEncoderContext->height = scaler.outputHeight();
+    videoEncoderContext->width = scaler.outputWidth();
+    videoEncoderContext->sample_aspect_ratio = videoDecoderContext->sample_aspect_ratio;
+    if (videoDecoderContext->sample_aspect_ratio.num > 0) {
+        // Keep the display aspect ratio when the storage aspect ratio changes.
+        videoEncoderContext->sample_aspect_ratio = av_mul_q(videoDecoderContext->sample_aspect_ratio,
+            av_make_q(videoDecoderContext->width * scaler.outputHeight(), videoDecoderContext->height * scaler.outputWidth()));
+    }
+    videoEncoderContext->pix_fmt = scaler.outputPixelFormat();
+    videoEncoderContext->time_base = scaler.outputTimeBase();
+    videoEncoderContext->framerate = scaler.outputFrameRate();
+    videoEncoderContext->max_b_frames = 5;
+
+    if (checkpointInterval > 0) {
+        // Segments may only be cut where no later frame references an earlier one.
+        videoEncoderContext->gop_size = FFMAX(1, static_cast<int>(checkpointInterval * av_q2d(scaler.outputFrameRate())));
+        videoEncoderContext->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+        av_opt_set(videoEncoderContext->priv_data, "x265-params", "open-gop=0", 0);
+    }
+
+    if (needsGlobalHeader()) {
+        videoEncoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(videoEncoderContext, videoEncoder, nullptr) < 0) {
+        std::cerr << "Could not open video encoder for " << outputFilename << std::endl;
+        return false;
+    }
+
+    return !measureQuality || initializeQualityMetrics();
+}
+
+// Opens the decoder that reconstructs the encoded frames for the PSNR/SSIM comparison.
+// A pixel format the metrics can't handle only disables them.
+bool RenditionOutput::initializeQualityMetrics() {
+    if (!QualityMeter::supports(videoEncoderContext->pix_fmt)) {
+        std::cerr << "Quality metrics not available for pixel format " << av_get_pix_fmt_name(videoEncoderContext->pix_fmt)
+                  << ", skipping them for " << outputFilename << std::endl;
+        return true;
+    }
+
+    const AVCodec* decoder = avcodec_find_decoder(AV_CODEC_ID_HEVC);
+    if (!decoder) {
+        std::cerr << "HEVC decoder for quality metrics not found." << std::endl;
+        return false;
+    }
+    qualityDecoderContext = avcodec_alloc_context3(decoder);
+    AVCodecParameters* parameters = avcodec_parameters_alloc();
+    bool configured = qualityDecoderContext && parameters &&
+        avcodec_parameters_from_context(parameters, videoEncoderContext) >= 0 &&
+        avcodec_parameters_to_context(qualityDecoderContext, parameters) >= 0;
+    avcodec_parameters_free(&parameters);
+    if (!configured) {
+        std::cerr << "Could not configure decoder for quality metrics." << std::endl;
+        return false;
+    }
+    qualityDecoderContext->pkt_timebase = videoEncoderContext->time_base;
+    qualityDecoderContext->thread_count = 0;
+    if (avcodec_open2(qualityDecoderContext, decoder, nullptr) < 0) {
+        std::cerr << "Could not open decoder for quality metrics." << std::endl;
+        return false;
+    }
+
+    reconstructedFrame = av_frame_alloc();
+    qualityLog.open(outputFilename + ".quality.log", std::ios::trunc);
+    if (!reconstructedFrame || !qualityLog) {
+        std::cerr << "Could not create quality log for " << outputFilename << std::endl;
+        return false;
+    }
+    qualityMeter = std::make_unique<QualityMeter>(qualityThreads);
+    return true;
+}
+
+// Records the shared audio encoder's output for this rendition's audio stream. Once both
+// encoders are known, a loaded checkpoint is validated against them and the output context
+// is created for the file encoding continues in.
+bool RenditionOutput::initializeAudioStream(const AVCodecContext* audioEncoderContext) {
+    // Every segment recreates the audio stream from this copy.
+    audioParameters = avcodec_parameters_alloc();
+    if (!audioParameters || avcodec_parameters_from_context(audioParameters, audioEncoderContext) < 0) {
+        std::cerr << "Could not copy audio parameters for " << outputFilename << std::endl;
+        return false;
+    }
+    audioTimeBase = audioEncoderContext->time_base;
+
+    if (checkpointInterval <= 0) {
+        return createOutputContext();
+    }
+
+    CheckpointState config;
+    config.width = videoEncoderContext->width;
+    config.height = videoEncoderContext->height;
+    config.pixelFormat = videoEncoderContext->pix_fmt;
+    config.videoTimeBase = videoEncoderContext->time_base;
+    config.audioTimeBase = audioEncoderContext->time_base;
+    config.gopSize = videoEncoderContext->gop_size;
+    config.maxBFrames = videoEncoderContext->max_b_frames;
+    config.bitRate = videoEncoderContext->bit_rate;
+    config.identifyInput(checkpointInput);
+
+    if (resuming && !checkpoint.sameInput(config)) {
+        std::cerr << "Checkpoint of " << outputFilename << " was made from a different or changed input, starting over." << std::endl;
+        discardCheckpoint();
+    }
+    else if (resuming && !checkpoint.sameEncoderConfig(config)) {
+        std::cerr << "Checkpoint of " << outputFilename << " was made with different settings, starting over." << std::endl;
+        discardCheckpoint();
+    }
+    config.segmentStarts = checkpoint.segmentStarts;
+    config.videoResumePts = checkpoint.videoResumePts;
+    config.audioResumePts = checkpoint.audioResumePts;
+    config.outputBytes = checkpoint.outputBytes;
+    config.complete = checkpoint.complete;
+    checkpoint = config;
+    currentFilename = segmentFilename(checkpoint.segments());
+
+    if (resuming && checkpoint.complete) {
+        if (verbose) {
+            std::cout << "All segments of " << outputFilename << " are already encoded, only joining them" << std::endl;
+        }
+        encodingComplete = true;
+    }
+    else if (resuming) {
+        if (verbose) {
+            std::cout << "Resuming " << outputFilename << " from segment " << checkpoint.segments() << std::endl;
+        }
+        // Frames and audio already in completed segments are decoded again but dropped.
+        scaler.skipBefore(checkpoint.videoResumePts);
+        segmentStartPts = checkpoint.videoResumePts;
+        audioSkipBefore = checkpoint.audioResumePts;
+        audioWrittenEnd = checkpoint.audioResumePts;
+    }
+    return createOutputContext();
+}
+
+// Deletes a rejected checkpoint and its segments, including the one that was being written
+// when the previous run stopped, so that nothing from it can end up in this run's output.
+void RenditionOutput::discardCheckpoint() {
+    for (int index = 0; index <= checkpoint.segments(); ++index) {
+        std::remove(segmentFilename(index).c_str());
+    }
+    std::remove(checkpointFilename().c_str());
+    resuming = false;
+    checkpoint = CheckpointState();
+}
+
+// Writes the header for the output file, unless there is nothing left to encode.
+bool RenditionOutput::writeOutputContext() {
+    return encodingComplete || openCurrentFile();
+}
+
+// Opens currentFilename and writes its header.
+bool RenditionOutput::openCurrentFile() {
+    if (!(outputFormatContext->oformat->flags & AVFMT_NOFILE)) {
+        // Mux through the write-behind context so the encoder never waits on disk.
+        if (!asyncOutput.open(currentFilename)) {
+            std::cerr << "Could not open output file." << std::endl;
+            return false;
+        }
+        outputFormatContext->pb = asyncOutput.context();
+        outputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+
+    if (avformat_write_header(outputFormatContext, nullptr) < 0) {
+        std::cerr << "Error occurred when opening output file." << std::endl;
+        return false;
+    }
+
+    headerWritten = true;
+    return true;
+}
+
+void RenditionOutput::start() {
+    worker = std::thread(&RenditionOutput::workerLoop, this);
+}
+
+void RenditionOutput::push(QueueItem item) {
+    std::unique_lock<std::mutex> lock(mutex);
+    // Bounded so that a slow rendition throttles the decoder instead of piling up frames.
+    spaceReady.wait(lock, [this] { return queue.size() < maxQueuedItems; });
+    queue.push_back(item);
+    itemReady.notify_one();
+}
+
+void RenditionOutput::pushFrame(const AVFrame* frame) {
+    QueueItem item;
+    item.frame = av_frame_clone(frame);
+    if (item.frame) {
+        push(item);
+    }
+}
+
+void RenditionOutput::pushAudioPacket(const AVPacket* packet, AVRational timeBase) {
+    QueueItem item;
+    item.packet = av_packet_clone(packet);
+    item.packetTimeBase = timeBase;
+    if (item.packet) {
+        push(item);
+    }
+}
+
+void RenditionOutput::finish() {
+    if (!worker.joinable() || finishing) {
+        return;
+    }
+    QueueItem item;
+    item.endOfStream = true;
+    push(item);
+    finishing = true;
+}
+
+void RenditionOutput::wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+void RenditionOutput::workerLoop() {
+    AVFrame* scaledFrame = av_frame_alloc();
+    while (true) {
+        QueueItem item;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            itemReady.wait(lock, [this] { return !queue.empty(); });
+            item = queue.front();
+            queue.pop_front();
+            spaceReady.notify_one();
+        }
+
+        if (item.endOfStream) {
+            if (!failed && !encodingComplete) {
+                encodeVideoFrame(nullptr);
+            }
+            break;
+        }
+        // After a fatal error, or with nothing left to encode, the queue is still drained so
+        // the decoder never blocks on us.
+        if (failed || encodingComplete) {
+            av_frame_free(&item.frame);
+            av_packet_free(&item.packet);
+            continue;
+        }
+        if (item.frame) {
+            // Convert to the encoder format/size; decimated frames are skipped.
+            int scaled = scaler.process(item.frame, scaledFrame);
+            if (scaled > 0) {
+                encodeVideoFrame(scaledFrame);
+            }
+            else if (scaled < 0) {
+                char error[AV_ERROR_MAX_STRING_SIZE] = {};
+                av_strerror(scaled, error, sizeof(error));
+                std::cerr << "Could not scale a frame of " << outputFilename << " (" << error << "), stopping this rendition." << std::endl;
+                failed = true;
+            }
+            av_frame_unref(scaledFrame);
+            av_frame_free(&item.frame);
+        }
+        if (item.packet) {
+            writeAudioPacket(item.packet, item.packetTimeBase);
+            av_packet_free(&item.packet);
+        }
+    }
+    av_frame_free(&scaledFrame);
+}
+
+// Sends a scaled frame (or nullptr to flush) to the video encoder and writes every packet it produces.
+void RenditionOutput::encodeVideoFrame(const AVFrame* frame) {
+    if (qualityMeter && frame) {
+        // Held by reference until its reconstruction comes out of the quality decoder.
+        AVFrame* reference = av_frame_clone(frame);
+        if (reference) {
+            av_frame_free(&qualityReferences[frame->pts]);
+            qualityReferences[frame->pts] = reference;
+        }
+    }
+
+    avcodec_send_frame(videoEncoderContext, frame);
+    AVPacket* outputPacket = av_packet_alloc();
+    while (avcodec_receive_packet(videoEncoderContext, outputPacket) == 0) {
+        if (qualityMeter) {
+            measureEncodedPacket(outputPacket);
+        }
+        // Closed GOPs make every keyframe a safe cut; take the first one that is at least
+        // half an interval into the segment.
+        if (checkpointInterval > 0 && segmentHasVideo && (outputPacket->flags & AV_PKT_FLAG_KEY) &&
+            outputPacket->pts - segmentStartPts >= videoEncoderContext->gop_size / 2 &&
+            !startNextSegment(outputPacket->pts)) {
+            std::cerr << "Could not start a new segment of " << outputFilename << ", stopping this rendition." << std::endl;
+            failed = true;
+            av_packet_unref(outputPacket);
+            break;
+        }
+        if (!headerWritten) {
+            av_packet_unref(outputPacket);
+            continue;
+        }
+        if (!segmentHasVideo) {
+            segmentStartPts = outputPacket->pts;
+            segmentHasVideo = true;
+        }
+
+        av_packet_rescale_ts(outputPacket, videoEncoderContext->time_base, outputVideoStream->time_base);
+        outputPacket->stream_index = outputVideoStream->index;
+        av_interleaved_write_frame(outputFormatContext, outputPacket);
+        av_packet_unref(outputPacket);
+    }
+    av_packet_free(&outputPacket);
+
+    if (qualityMeter && !frame) {
+        measureEncodedPacket(nullptr);
+    }
+}
+
+// Decodes an encoded packet (nullptr drains the decoder) and measures every reconstructed
+// frame against the encoder input with the same pts.
+void RenditionOutput::measureEncodedPacket(const AVPacket* packet) {
+    if (avcodec_send_packet(qualityDecoderContext, packet) < 0) {
+        std::cerr << "Quality decoder rejected a packet of " << outputFilename << std::endl;
+        return;
+    }
+    while (avcodec_receive_frame(qualityDecoderContext, reconstructedFrame) == 0) {
+        int64_t pts = reconstructedFrame->pts != AV_NOPTS_VALUE ? reconstructedFrame->pts : reconstructedFrame->best_effort_timestamp;
+        // Anything older than this frame will never be matched.
+        auto reference = qualityReferences.begin();
+        while (reference != qualityReferences.end() && reference->first < pts) {
+            av_frame_free(&reference->second);
+            reference = qualityReferences.erase(reference);
+        }
+
+        if (reference != qualityReferences.end() && reference->first == pts) {
+            FrameQuality quality;
+            if (qualityMeter->measure(reference->second, reconstructedFrame, quality)) {
+                qualityLog << "n:" << qualityMeter->summary().frames << " pts:" << pts << " "
+                           << QualityMeter::format(quality.plane, quality.planes, quality.all, videoEncoderContext->pix_fmt) << "\n";
+            }
+            av_frame_free(&reference->second);
+            qualityReferences.erase(reference);
+        }
+        av_frame_unref(reconstructedFrame);
+    }
+}
+
+void RenditionOutput::writeAudioPacket(AVPacket* packet, AVRational timeBase) {
+    if (!headerWritten) {
+        return;
+    }
+    if (packet->pts != AV_NOPTS_VALUE) {
+        if (audioSkipBefore != AV_NOPTS_VALUE && packet->pts < audioSkipBefore) {
+            return;
+        }
+        audioWrittenEnd = FFMAX(audioWrittenEnd, packet->pts + packet->duration);
+    }
+
+    av_packet_rescale_ts(packet, timeBase, outputAudioStream->time_base);
+    packet->stream_index = outputAudioStream->index;
+    av_interleaved_write_frame(outputFormatContext, packet);
+}
+
+// Writes the trailer of the current segment (or the whole output) and closes its file.
+bool RenditionOutput::closeSegment() {
+    bool success = true;
+    if (outputFormatContext && headerWritten) {
+        if (av_write_trailer(outputFormatContext) < 0) {
+            success = false;
+        }
+        headerWritten = false;
+        if (outputFormatContext->pb) {
+            int64_t size = avio_size(outputFormatContext->pb);
+            checkpoint.outputBytes += FFMAX(0, size);
+        }
+    }
+    if (!asyncOutput.close()) {
+        std::cerr << "Error occurred while writing output file " << currentFilename << std::endl;
+        success = false;
+    }
+    if (outputFormatContext) {
+        outputFormatContext->pb = nullptr;
+    }
+    avformat_free_context(outputFormatContext);
+    outputFormatContext = nullptr;
+    return success;
+}
+
+// Completes the current segment, records it in the checkpoint and opens the next one,
+// which starts with the keyframe at videoPts.
+bool RenditionOutput::startNextSegment(int64_t videoPts) {
+    if (!closeSegment()) {
+        return false;
+    }
+
+    checkpoint.segmentStarts.push_back(segmentStartPts);
+    checkpoint.videoResumePts = videoPts;
+    checkpoint.audioResumePts = audioWrittenEnd;
+    if (!checkpoint.save(checkpointFilename())) {
+        return false;
+    }
+
+    currentFilename = segmentFilename(checkpoint.segments());
+    if (!createOutputContext()) {
+        return false;
+    }
+
+    segmentHasVideo = false;
+    return openCurrentFile();
+}
+
+// Remuxes all completed segments, in order, into the final output file. Each segment is
+// placed on the timeline by the start recorded in the checkpoint rather than by its own
+// timestamps, which the segment muxer may have shifted.
+bool RenditionOutput::concatenateSegments() {
+    currentFilename = outputFilename;
+    avformat_alloc_output_context2(&outputFormatContext, nullptr, nullptr, outputFilename.c_str());
+    if (!outputFormatContext) {
+        std::cerr << "Could not create output context for " << outputFilename << std::endl;
+        return false;
+    }
+
+    bool success = true;
+    int videoIndex = -1;
+    std::vector<int64_t> lastDts;
+    std::vector<AVPacket*> pending;
+    AVPacket* packet = av_packet_alloc();
+
+    auto writePacket = [&](AVPacket* segmentPacket, AVFormatContext* segmentContext, int64_t videoOffset) {
+        if (!success) {
+            av_packet_unref(segmentPacket);
+            return;
+        }
+        AVStream* stream = outputFormatContext->streams[segmentPacket->stream_index];
+        av_packet_rescale_ts(segmentPacket, segmentContext->streams[segmentPacket->stream_index]->time_base, stream->time_base);
+        int64_t offset = av_rescale_q(videoOffset, checkpoint.videoTimeBase, stream->time_base);
+        if (segmentPacket->pts != AV_NOPTS_VALUE) {
+            segmentPacket->pts += offset;
+        }
+        if (segmentPacket->dts != AV_NOPTS_VALUE) {
+            segmentPacket->dts += offset;
+            // Segments cut at closed GOPs follow each other exactly; going back in time
+            // means they overlap and the output would be corrupt.
+            int64_t& previous = lastDts[segmentPacket->stream_index];
+            if (previous != AV_NOPTS_VALUE && segmentPacket->dts <= previous) {
+                std::cerr << "Segments of " << outputFilename << " overlap in stream " << segmentPacket->stream_index
+                          << " (dts " << segmentPacket->dts << " after " << previous << ")" << std::endl;
+                success = false;
+                av_packet_unref(segmentPacket);
+                return;
+            }
+            previous = segmentPacket->dts;
+        }
+        if (av_interleaved_write_frame(outputFormatContext, segmentPacket) < 0) {
+            success = false;
+        }
+        av_packet_unref(segmentPacket);
+    };
+
+    for (int index = 0; success && index < checkpoint.segments(); ++index) {
+        std::string segment = segmentFilename(index);
+        AVFormatContext* segmentContext = nullptr;
+        if (avformat_open_input(&segmentContext, segment.c_str(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(segmentContext, nullptr) < 0) {
+            std::cerr << "Could not open segment " << segment << std::endl;
+            avformat_close_input(&segmentContext);
+            success = false;
+            break;
+        }
+
+        if (index == 0) {
+            for (unsigned int i = 0; i < segmentContext->nb_streams; ++i) {
+                AVStream* stream = avformat_new_stream(outputFormatContext, nullptr);
+                avcodec_parameters_copy(stream->codecpar, segmentContext->streams[i]->codecpar);
+                stream->codecpar->codec_tag = 0;
+                bool isVideo = segmentContext->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+                stream->time_base = isVideo ? checkpoint.videoTimeBase : checkpoint.audioTimeBase;
+                if (isVideo) {
+                    videoIndex = static_cast<int>(i);
+                }
+            }
+            lastDts.assign(segmentContext->nb_streams, AV_NOPTS_VALUE);
+            success = openCurrentFile();
+        }
+
+        // Packets are held back until the segment's first video packet (its IDR, which
+        // carries the lowest pts of the segment) tells us how far to move the segment.
+        bool offsetKnown = false;
+        int64_t videoOffset = 0;
+        while (success && av_read_frame(segmentContext, packet) >= 0) {
+            if (packet->stream_index >= static_cast<int>(outputFormatContext->nb_streams)) {
+                av_packet_unref(packet);
+                continue;
+            }
+            if (!offsetKnown && packet->stream_index == videoIndex && packet->pts != AV_NOPTS_VALUE) {
+                int64_t firstPts = av_rescale_q(packet->pts, segmentContext->streams[videoIndex]->time_base, checkpoint.videoTimeBase);
+                videoOffset = checkpoint.segmentStarts[index] - firstPts;
+                offsetKnown = true;
+                for (AVPacket* held : pending) {
+                    writePacket(held, segmentContext, videoOffset);
+                    av_packet_free(&held);
+                }
+                pending.clear();
+            }
+            if (!offsetKnown) {
+                pending.push_back(av_packet_clone(packet));
+                av_packet_unref(packet);
+                continue;
+            }
+            writePacket(packet, segmentContext, videoOffset);
+        }
+        for (AVPacket* held : pending) {
+            if (success) {
+                writePacket(held, segmentContext, videoOffset);
+            }
+            av_packet_free(&held);
+        }
+        pending.clear();
+        avformat_close_input(&segmentContext);
+    }
+    av_packet_free(&packet);
+
+    return closeSegment() && success;
+}
+
+bool RenditionOutput::finalize() {
+    if (failed) {
+        closeSegment();
+        return false;
+    }
+    if (checkpointInterval <= 0) {
+        return closeSegment();
+    }
+
+    if (!closeSegment()) {
+        return false;
+    }
+    if (!encodingComplete) {
+        // Marked complete so that a rerun after a failed join only joins again instead of
+        // encoding the last segment a second time.
+        checkpoint.segmentStarts.push_back(segmentStartPts);
+        checkpoint.videoResumePts = segmentStartPts;
+        checkpoint.audioResumePts = audioWrittenEnd;
+        checkpoint.complete = true;
+        if (!checkpoint.save(checkpointFilename())) {
+            return false;
+        }
+    }
+
+    if (!concatenateSegments()) {
+        std::cerr << "Could not join segments into " << outputFilename << ", keeping them for a retry." << std::endl;
+        return false;
+    }
+
+    for (int index = 0; index < checkpoint.segments(); ++index) {
+        std::remove(segmentFilename(index).c_str());
+    }
+    std::remove(checkpointFilename().c_str());
+    return true;
+}
+
+// Writes the trailer and releases the encoder and output file. An unfinished segment is
+// left out of the checkpoint and gets overwritten when the job resumes.
+void RenditionOutput::cleanup() {
+    closeSegment();
+    avcodec_free_context(&videoEncoderContext);
+    avcodec_parameters_free(&audioParameters);
+
+    avcodec_free_context(&qualityDecoderContext);
+    av_frame_free(&reconstructedFrame);
+    for (auto& reference : qualityReferences) {
+        av_frame_free(&reference.second);
+    }
+    qualityReferences.clear();
+    if (qualityLog.is_open()) {
+        qualityLog.close();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (QueueItem& item : queue) {
+        av_frame_free(&item.frame);
+        av_packet_free(&item.packet);
+    }
+    queue.clear();
+}
@@ -0,0 +1,157 @@
+#ifndef RENDITIONOUTPUT_H
+#define RENDITIONOUTPUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncIO.hpp"
+#include "Checkpoint.hpp"
+#include "FrameScaler.hpp"
+#include "QualityMetrics.hpp"
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+}
+
+// One output of a conversion: a file name plus the scaling applied before encoding.
+struct Rendition {
+    std::string outputFilename;
+    ScalingOptions scaling;
+};
+
+// Builds one rendition per comma separated size, named <stem>_<size><ext> after outputFile;
+// "<N>p" keeps the aspect ratio at height N, anything else is parsed as an FFmpeg video size
+// (WxH or an abbreviation such as hd720).
+bool parseLadder(const std::string& ladder, const std::string& outputFile, const ScalingOptions& base, std::vector<Rendition>& renditions);
+
+// Owns the scaler, HEVC encoder and muxer of a single rendition. Decoded frames and
+// already-encoded audio packets are queued by reference and processed on the
+// rendition's own thread, so several renditions encode in parallel from one decode.
+class RenditionOutput {
+public:
+    static constexpr size_t maxQueuedItems = 16;
+
+    explicit RenditionOutput(const Rendition& rendition, SwsContextPool* scalerPool = nullptr)
+        : outputFilename(rendition.outputFilename), scaler(rendition.scaling, scalerPool) {}
+    ~RenditionOutput();
+
+    RenditionOutput(const RenditionOutput&) = delete;
+    RenditionOutput& operator=(const RenditionOutput&) = delete;
+
+    // Splits the output into closed-GOP segments of roughly this many seconds and records
+    // progress after each one so an interrupted run can resume; must precede initializeOutputFile().
+    // A checkpoint only resumes for the same, unchanged inputFilename.
+    void enableCheckpoints(int intervalSeconds, const std::string& inputFilename) {
+        checkpointInterval = intervalSeconds;
+        checkpointInput = inputFilename;
+    }
+    // Decodes every encoded packet back and compares it with the frame that went into the
+    // encoder; per-frame PSNR/SSIM go to <output>.quality.log. Must precede initializeVideoEncoder().
+    void enableQualityMetrics(int threads) { qualityThreads = threads; measureQuality = true; }
+    // Whether resuming is announced on std::cout.
+    void setVerbose(bool enabled) { verbose = enabled; }
+    // Where decoding must restart for this rendition, in AV_TIME_BASE units (0 for a fresh run,
+    // INT64_MAX when a previous run encoded everything).
+    int64_t resumeTime() const;
+    // A previous run encoded every segment; this run only joins them and ignores all input.
+    bool alreadyEncoded() const { return encodingComplete; }
+
+    bool initializeOutputFile();
+    bool needsGlobalHeader() const;
+    bool initializeVideoEncoder(AVFormatContext* inputFormatContext, AVStream* videoStream, const AVCodecContext* videoDecoderContext);
+    bool initializeAudioStream(const AVCodecContext* audioEncoderContext);
+    bool writeOutputContext();
+
+    void start();
+    // Both take a new reference; the caller keeps ownership of its own.
+    void pushFrame(const AVFrame* frame);
+    void pushAudioPacket(const AVPacket* packet, AVRational timeBase);
+    // Queues the end of stream: the worker flushes the video encoder and exits.
+    void finish();
+    void wait();
+    // Closes the last segment and, when checkpointing, joins all segments into the output file.
+    bool finalize();
+    void cleanup();
+
+    const std::string& filename() const { return outputFilename; }
+    AVPixelFormat pixelFormat() const { return scaler.outputPixelFormat(); }
+    // nullptr unless quality metrics are enabled and supported for the encoder's pixel format.
+    const QualityMeter* quality() const { return qualityMeter.get(); }
+
+private:
+    struct QueueItem {
+        AVFrame* frame = nullptr;
+        AVPacket* packet = nullptr;
+        AVRational packetTimeBase = { 0, 1 };
+        bool endOfStream = false;
+    };
+
+    std::string outputFilename;
+    FrameScaler scaler;
+    AsyncOutputFile asyncOutput;
+
+    AVFormatContext* outputFormatContext = nullptr;
+    AVCodecContext* videoEncoderContext = nullptr;
+    AVStream* outputVideoStream = nullptr;
+    AVStream* outputAudioStream = nullptr;
+    bool headerWritten = false;
+    bool finishing = false;
+    bool failed = false;  // set on the worker thread; read after wait()
+    bool verbose = true;
+    bool encodingComplete = false;
+
+    int checkpointInterval = 0;
+    std::string checkpointInput;
+    CheckpointState checkpoint;
+    bool resuming = false;
+    std::string currentFilename;
+    AVCodecParameters* audioParameters = nullptr;
+    AVRational audioTimeBase = { 0, 1 };
+    int64_t segmentStartPts = 0;
+    bool segmentHasVideo = false;
+    int64_t audioSkipBefore = AV_NOPTS_VALUE;
+    int64_t audioWrittenEnd = 0;
+
+    bool measureQuality = false;
+    int qualityThreads = 0;
+    std::unique_ptr<QualityMeter> qualityMeter;
+    AVCodecContext* qualityDecoderContext = nullptr;
+    std::map<int64_t, AVFrame*> qualityReferences;
+    AVFrame* reconstructedFrame = nullptr;
+    std::ofstream qualityLog;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable itemReady;
+    std::condition_variable spaceReady;
+    std::deque<QueueItem> queue;
+
+    std::string segmentFilename(int index) const;
+    std::string checkpointFilename() const { return outputFilename + ".checkpoint"; }
+    bool createOutputContext();
+    void discardCheckpoint();
+    bool openCurrentFile();
+    bool closeSegment();
+    bool startNextSegment(int64_t videoPts);
+    bool concatenateSegments();
+
+    void push(QueueItem item);
+    void workerLoop();
+    void encodeVideoFrame(const AVFrame* frame);
+    bool initializeQualityMetrics();
+    void measureEncodedPacket(const AVPacket* packet);
+    void writeAudioPacket(AVPacket* packet, AVRational timeBase);
+};
+
+#endif
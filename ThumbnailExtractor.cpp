@@ -0,0 +1,323 @@
+#include "ThumbnailExtractor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include <opencv2/opencv.hpp>
+
+#include "ColorConversion.hpp"
+#include "FrameScaler.hpp"
+
+extern "C"
+{
+    #include <libavformat/avformat.h>
+    #include <libavcodec/avcodec.h>
+    #include <libavutil/avutil.h>
+}
+
+namespace {
+
+struct Target {
+    int64_t seekTimestamp;     // stream time base; the seek lands on the keyframe at or before it
+    int64_t presentTimestamp;  // first frame at or after this is taken, AV_NOPTS_VALUE = first decoded
+};
+
+// One demuxer/decoder pair. Seeking moves a format context's read position, so parallel
+// workers can't share one.
+class DecodeSession {
+public:
+    DecodeSession() = default;
+    ~DecodeSession();
+
+    DecodeSession(const DecodeSession&) = delete;
+    DecodeSession& operator=(const DecodeSession&) = delete;
+
+    bool open(const std::string& filename, bool keyframesOnly);
+    // Seeks and decodes forward until the frame for target is in frame.
+    bool decodeAt(const Target& target, AVFrame* frame);
+
+    AVStream* stream() const { return formatContext->streams[streamIndex]; }
+    int64_t duration() const;
+
+private:
+    AVFormatContext* formatContext = nullptr;
+    AVCodecContext* decoderContext = nullptr;
+    AVPacket* packet = nullptr;
+    int streamIndex = -1;
+};
+
+DecodeSession::~DecodeSession() {
+    av_packet_free(&packet);
+    avcodec_free_context(&decoderContext);
+    avformat_close_input(&formatContext);
+}
+
+bool DecodeSession::open(const std::string& filename, bool keyframesOnly) {
+    if (avformat_open_input(&formatContext, filename.c_str(), nullptr, nullptr) < 0) {
+        std::cerr << "Could not open input file " << filename << std::endl;
+        return false;
+    }
+    if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+        std::cerr << "Could not find stream information" << std::endl;
+        return false;
+    }
+
+    const AVCodec* decoder = nullptr;
+    streamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (streamIndex < 0 || !decoder) {
+        std::cerr << "Could not find video stream in " << filename << std::endl;
+        return false;
+    }
+    // Let the demuxer skip everything but the video packets.
+    for (unsigned int i = 0; i < formatContext->nb_streams; ++i) {
+        if (static_cast<int>(i) != streamIndex) {
+            formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    decoderContext = avcodec_alloc_context3(decoder);
+    packet = av_packet_alloc();
+    if (!decoderContext || !packet ||
+        avcodec_parameters_to_context(decoderContext, stream()->codecpar) < 0) {
+        std::cerr << "Could not allocate video decoder context" << std::endl;
+        return false;
+    }
+    // Parallelism comes from the workers; frame threading would only add decoder latency.
+    decoderContext->thread_count = 1;
+    if (keyframesOnly) {
+        decoderContext->skip_frame = AVDISCARD_NONKEY;
+    }
+    if (avcodec_open2(decoderContext, decoder, nullptr) < 0) {
+        std::cerr << "Could not open video decoder" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int64_t DecodeSession::duration() const {
+    if (stream()->duration > 0) {
+        return stream()->duration;
+    }
+    if (formatContext->duration > 0) {
+        return av_rescale_q(formatContext->duration, av_make_q(1, AV_TIME_BASE), stream()->time_base);
+    }
+    return 0;
+}
+
+bool DecodeSession::decodeAt(const Target& target, AVFrame* frame) {
+    if (av_seek_frame(formatContext, streamIndex, target.seekTimestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "Could not seek to " << target.seekTimestamp << std::endl;
+        return false;
+    }
+    avcodec_flush_buffers(decoderContext);
+
+    bool draining = false;
+    while (true) {
+        int ret = avcodec_receive_frame(decoderContext, frame);
+        if (ret == 0) {
+            int64_t timestamp = frame->best_effort_timestamp;
+            if (target.presentTimestamp == AV_NOPTS_VALUE || timestamp == AV_NOPTS_VALUE ||
+                timestamp >= target.presentTimestamp) {
+                return true;
+            }
+            continue;
+        }
+        if (ret != AVERROR(EAGAIN) || draining) {
+            return false;
+        }
+
+        if (av_read_frame(formatContext, packet) < 0) {
+            avcodec_send_packet(decoderContext, nullptr);
+            draining = true;
+            continue;
+        }
+        if (packet->stream_index == streamIndex) {
+            ret = avcodec_send_packet(decoderContext, packet);
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                av_packet_unref(packet);
+                std::cerr << "Error sending packet to video decoder" << std::endl;
+                return false;
+            }
+        }
+        av_packet_unref(packet);
+    }
+}
+
+// Keyframe timestamps from the demuxer's index, in stream time base. Containers with a
+// complete index (MP4, Matroska with cues) list every keyframe right after opening.
+std::vector<int64_t> keyframeIndex(AVStream* stream) {
+    std::vector<int64_t> keyframes;
+    int entries = avformat_index_get_entries_count(stream);
+    for (int i = 0; i < entries; ++i) {
+        const AVIndexEntry* entry = avformat_index_get_entry(stream, i);
+        if (entry && (entry->flags & AVINDEX_KEYFRAME)) {
+            keyframes.push_back(entry->timestamp);
+        }
+    }
+    std::sort(keyframes.begin(), keyframes.end());
+    keyframes.erase(std::unique(keyframes.begin(), keyframes.end()), keyframes.end());
+    return keyframes;
+}
+
+// Spreads count targets evenly over the stream. Without exact, each snaps to the nearest
+// keyframe and targets sharing one are merged.
+std::vector<Target> buildTargets(DecodeSession& session, const ThumbnailOptions& options) {
+    std::vector<Target> targets;
+    int64_t duration = session.duration();
+    if (duration <= 0) {
+        std::cerr << "Could not determine the video duration" << std::endl;
+        return targets;
+    }
+    int64_t start = session.stream()->start_time != AV_NOPTS_VALUE ? session.stream()->start_time : 0;
+
+    std::vector<int64_t> keyframes = keyframeIndex(session.stream());
+    if (keyframes.empty()) {
+        std::cout << "No keyframe index, seeking by timestamp" << std::endl;
+    }
+
+    for (int i = 0; i < options.count; ++i) {
+        int64_t time = start + av_rescale(duration, 2 * i + 1, 2 * static_cast<int64_t>(options.count));
+        if (keyframes.empty()) {
+            targets.push_back({ time, options.exact ? time : AV_NOPTS_VALUE });
+            continue;
+        }
+
+        auto after = std::lower_bound(keyframes.begin(), keyframes.end(), time);
+        auto upper = std::upper_bound(keyframes.begin(), keyframes.end(), time);
+        auto before = upper == keyframes.begin() ? upper : upper - 1;
+        if (options.exact) {
+            targets.push_back({ *before, time });
+            continue;
+        }
+        int64_t keyframe = after == keyframes.end() || time - *before <= *after - time ? *before : *after;
+        if (targets.empty() || targets.back().seekTimestamp != keyframe) {
+            targets.push_back({ keyframe, AV_NOPTS_VALUE });
+        }
+    }
+    return targets;
+}
+
+} // namespace
+
+ThumbnailExtractor::ThumbnailExtractor(const std::string& inputFilename, const std::string& outputFilename, const ThumbnailOptions& options)
+    : inputFilename(inputFilename), options(options)
+{
+    size_t slash = outputFilename.find_last_of("/\\");
+    size_t dot = outputFilename.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        outputStem = outputFilename;
+        outputExtension = ".jpg";
+    }
+    else {
+        outputStem = outputFilename.substr(0, dot);
+        outputExtension = outputFilename.substr(dot);
+    }
+}
+
+std::string ThumbnailExtractor::thumbnailFilename(size_t index) const {
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%03zu", index + 1);
+    return outputStem + suffix + outputExtension;
+}
+
+bool ThumbnailExtractor::extract() {
+    results.clear();
+    if (options.count <= 0) {
+        std::cerr << "Thumbnail count must be positive" << std::endl;
+        return false;
+    }
+
+    auto first = std::make_unique<DecodeSession>();
+    if (!first->open(inputFilename, !options.exact)) {
+        return false;
+    }
+    std::vector<Target> targets = buildTargets(*first, options);
+    if (targets.empty()) {
+        return false;
+    }
+
+    size_t workers = options.threads > 0 ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, targets.size());
+
+    std::vector<Thumbnail> extracted(targets.size());
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+
+    auto work = [&](std::unique_ptr<DecodeSession> session) {
+        if (!session) {
+            session = std::make_unique<DecodeSession>();
+            if (!session->open(inputFilename, !options.exact)) {
+                failed = true;
+                return;
+            }
+        }
+        AVRational timeBase = session->stream()->time_base;
+        SwsContextPool pool(1, SWS_BICUBIC);
+        AVFrame* frame = av_frame_alloc();
+        if (!frame) {
+            failed = true;
+            return;
+        }
+
+        for (size_t i = next++; i < targets.size(); i = next++) {
+            if (!session->decodeAt(targets[i], frame)) {
+                std::cerr << "Could not decode thumbnail " << i + 1 << std::endl;
+                failed = true;
+                continue;
+            }
+
+            int width = options.width > 0 ? options.width : frame->width;
+            int height = std::max(1, static_cast<int>(av_rescale(width, frame->height, frame->width)));
+            SwsContext* scaler = pool.acquire(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                              width, height, AV_PIX_FMT_BGR24);
+            if (!scaler) {
+                std::cerr << "Could not create scaler for thumbnail " << i + 1 << std::endl;
+                failed = true;
+                av_frame_unref(frame);
+                continue;
+            }
+
+            // BGR like cv::imread, so thumbnails go through the same conversion as -image.
+            cv::Mat bgrImage(height, width, CV_8UC3);
+            uint8_t* dstData[4] = { bgrImage.data, nullptr, nullptr, nullptr };
+            int dstLinesize[4] = { static_cast<int>(bgrImage.step), 0, 0, 0 };
+            sws_scale(scaler, frame->data, frame->linesize, 0, frame->height, dstData, dstLinesize);
+
+            cv::Mat yuvImage;
+            ColorConversion::convertRGBtoYUV_JPEG(bgrImage, yuvImage, false);
+
+            std::string filename = thumbnailFilename(i);
+            if (!cv::imwrite(filename, yuvImage)) {
+                std::cerr << "Failed to save " << filename << std::endl;
+                failed = true;
+            }
+            else {
+                int64_t timestamp = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : targets[i].seekTimestamp;
+                extracted[i] = { timestamp * av_q2d(timeBase), filename };
+            }
+            av_frame_unref(frame);
+        }
+        av_frame_free(&frame);
+    };
+
+    // The session that built the index becomes the first worker.
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < workers; ++i) {
+        threads.emplace_back(work, nullptr);
+    }
+    work(std::move(first));
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (Thumbnail& thumbnail : extracted) {
+        if (!thumbnail.filename.empty()) {
+            results.push_back(std::move(thumbnail));
+        }
+    }
+    return !failed;
+}
@@ -0,0 +1,40 @@
+#ifndef THUMBNAILEXTRACTOR_H
+#define THUMBNAILEXTRACTOR_H
+
+#include <string>
+#include <vector>
+
+struct ThumbnailOptions {
+    int count = 10;      // spread evenly over the video stream
+    int width = 0;       // 0 keeps the source width, the height follows the aspect ratio
+    int threads = 0;     // parallel seek/decode workers, 0 = one per core
+    bool exact = false;  // decode up to the exact target time instead of taking the nearest keyframe
+};
+
+struct Thumbnail {
+    double time;         // presentation time of the decoded frame in seconds
+    std::string filename;
+};
+
+// Extracts preview images by seeking straight to the keyframes listed in the demuxer's index
+// and decoding only those frames, so the cost grows with the number of thumbnails rather
+// than with the duration of the file. Every worker thread has its own demuxer and decoder.
+class ThumbnailExtractor {
+public:
+    // Images are written as <output stem>_NNN<output extension>, ".jpg" if there is none.
+    ThumbnailExtractor(const std::string& inputFilename, const std::string& outputFilename, const ThumbnailOptions& options = {});
+
+    bool extract();
+    const std::vector<Thumbnail>& thumbnails() const { return results; }
+
+private:
+    std::string inputFilename;
+    std::string outputStem;
+    std::string outputExtension;
+    ThumbnailOptions options;
+    std::vector<Thumbnail> results;
+
+    std::string thumbnailFilename(size_t index) const;
+};
+
+#endif
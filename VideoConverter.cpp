@@ -2,8 +2,15 @@
 
 // Opens the input file and prepares the format context.
 bool VideoConverter::openInputFile() {
+    // Demux through the read-ahead context so disk latency overlaps with decoding.
+    if (!asyncInput.open(inputFilename)) {
+        return false;
+    }
+
     // Allocate an AVFormatContext for the input file.
     inputFormatContext = avformat_alloc_context();
+    inputFormatContext->pb = asyncInput.context();
+    inputFormatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
     if (avformat_open_input(&inputFormatContext, inputFilename.c_str(), nullptr, nullptr) < 0) {
         std::cerr << "Could not open input file: " << inputFilename << std::endl;
         return false;
@@ -54,77 +61,73 @@ bool VideoConverter::initializeDecoderContexts() {
     return true;
 }
 
-// Writes the header for the output file.
+// Writes the header for every output file.
 bool VideoConverter::writeOutputContext() {
-
-    if (!(outputFormatContext->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&outputFormatContext->pb, outputFilename.c_str(), AVIO_FLAG_WRITE) < 0) {
-            std::cerr << "Could not open output file." << std::endl;
+    for (auto& output : outputs) {
+        if (!output->writeOutputContext()) {
             return false;
         }
     }
-
-    if (avformat_write_header(outputFormatContext, nullptr) < 0) {
-        std::cerr << "Error occurred when opening output file." << std::endl;
-        return false;
-    }
-
     return true;
 }
 
-// Initializes the encoder contexts for both video and audio streams.
-bool VideoConverter::initializeOutputFile() {
-    avformat_alloc_output_context2(&outputFormatContext, nullptr, nullptr, outputFilename.c_str());
-    if (!outputFormatContext) {
-        std::cerr << "Could not create output context." << std::endl;
-        return false;
+// Seeks the input back to the earliest point any rendition still has to encode. Seeking
+// lands on a keyframe at or before it; renditions drop what they already have.
+bool VideoConverter::seekToCheckpoint() {
+    int64_t resumeTime = INT64_MAX;
+    for (auto& output : outputs) {
+        resumeTime = FFMIN(resumeTime, output->resumeTime());
     }
-
-    outputVideoStream = avformat_new_stream(outputFormatContext, nullptr);
-    if (!outputVideoStream) {
-        std::cerr << "Failed to allocate video output stream." << std::endl;
-        return false;
+    if (resumeTime <= 0 || resumeTime == INT64_MAX) {
+        return true;
     }
 
-    outputAudioStream = avformat_new_stream(outputFormatContext, nullptr);
-    if (!outputAudioStream) {
-        std::cerr << "Failed to allocate audio output stream." << std::endl;
+    int64_t timestamp = av_rescale_q(resumeTime, av_make_q(1, AV_TIME_BASE), videoStream->time_base);
+    if (av_seek_frame(inputFormatContext, videoStream->index, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        std::cerr << "Could not seek input to the checkpoint." << std::endl;
         return false;
     }
-
     return true;
 }
 
-// Encodes and writes frames from the input file to the output file.
-bool VideoConverter::initializeEncoderContexts() {
-    const AVCodec* videoEncoder = avcodec_find_encoder(AV_CODEC_ID_HEVC);
-    if (!videoEncoder) {
-        std::cerr << "Necessary video encoder not found." << std::endl;
+// Creates one output per rendition and loads its checkpoint; the format contexts follow
+// once the encoders are open.
+bool VideoConverter::initializeOutputFile() {
+    if (renditions.empty()) {
+        std::cerr << "No output renditions requested." << std::endl;
         return false;
     }
 
-    videoEncoderContext = avcodec_alloc_context3(videoEncoder);
-    videoEncoderContext->height = videoDecoderContext->height;
-    videoEncoderContext->width = videoDecoderContext->width;
-    videoEncoderContext->sample_aspect_ratio = videoDecoderContext->sample_aspect_ratio;
-    videoEncoderContext->pix_fmt = AV_PIX_FMT_YUV420P;
-    videoEncoderContext->time_base = av_inv_q(av_guess_frame_rate(inputFormatContext, videoStream, nullptr));
-    videoEncoderContext->framerate = av_guess_frame_rate(inputFormatContext, videoStream, nullptr);
-    videoEncoderContext->max_b_frames = 5;
-
-    outputVideoStream->time_base = videoEncoderContext->time_base;
-
-    if (outputFormatContext->oformat->flags & AVFMT_GLOBALHEADER) {
-        videoEncoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    scalerPools.resize(FFMAX(scalerPools.size(), renditions.size()));
+    for (size_t i = 0; i < renditions.size(); ++i) {
+        const Rendition& rendition = renditions[i];
+        std::unique_ptr<SwsContextPool>& pool = scalerPools[i];
+        if (!pool || !pool->matches(rendition.scaling.threads, rendition.scaling.flags)) {
+            pool = std::make_unique<SwsContextPool>(rendition.scaling.threads, rendition.scaling.flags);
+        }
+        outputs.push_back(std::make_unique<RenditionOutput>(rendition, pool.get()));
+        if (checkpointInterval > 0) {
+            outputs.back()->enableCheckpoints(checkpointInterval, inputFilename);
+        }
+        if (measureQuality) {
+            outputs.back()->enableQualityMetrics(qualityThreads);
+        }
+        outputs.back()->setVerbose(verbose);
+        if (!outputs.back()->initializeOutputFile()) {
+            return false;
+        }
     }
+    return true;
+}
 
-    if (avcodec_open2(videoEncoderContext, videoEncoder, nullptr) < 0) {
-        std::cerr << "Could not open video encoder." << std::endl;
-        return false;
+// Initializes one video encoder per rendition and the audio encoder they all share.
+bool VideoConverter::initializeEncoderContexts() {
+    for (auto& output : outputs) {
+        if (!output->initializeVideoEncoder(inputFormatContext, videoStream, videoDecoderContext)) {
+            return false;
+        }
     }
 
-    avcodec_parameters_from_context(outputVideoStream->codecpar, videoEncoderContext);
-
     const AVCodec* audioEncoder = avcodec_find_encoder(AV_CODEC_ID_AAC);
     if (!audioEncoder) {
         std::cerr << "Necessary audio encoder not found." << std::endl;
@@ -137,10 +140,12 @@ bool VideoConverter::initializeEncoderContexts() {
     audioEncoderContext->sample_fmt = audioEncoder->sample_fmts[0];
     audioEncoderContext->time_base = { 1, audioEncoderContext->sample_rate };
 
-    outputAudioStream->time_base = audioEncoderContext->time_base;
-
-    if (outputFormatContext->oformat->flags & AVFMT_GLOBALHEADER) {
-        audioEncoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    // Audio is encoded once and muxed into every output, so one output needing
+    // global headers is enough to request them.
+    for (auto& output : outputs) {
+        if (output->needsGlobalHeader()) {
+            audioEncoderContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
     }
 
     if (avcodec_open2(audioEncoderContext, audioEncoder, nullptr) < 0) {
@@ -148,29 +153,34 @@ bool VideoConverter::initializeEncoderContexts() {
         return false;
     }
 
-    avcodec_parameters_from_context(outputAudioStream->codecpar, audioEncoderContext);
+    for (auto& output : outputs) {
+        if (!output->initializeAudioStream(audioEncoderContext)) {
+            return false;
+        }
+    }
 
     return true;
 }
 
-// Encodes and writes frames from the input file to the output file.
+// Decodes the input once and fans frames and encoded audio out to every rendition.
 void VideoConverter::encodeAndWriteFrames() {
+    bool framesNeeded = false;
+    for (auto& output : outputs) {
+        output->start();
+        framesNeeded = framesNeeded || !output->alreadyEncoded();
+    }
+    // Every rendition was encoded by an earlier run and only needs its segments joined.
+    if (!framesNeeded) {
+        return;
+    }
+
+    int lastPercent = -1;
     AVPacket* packet = av_packet_alloc();
     while (av_read_frame(inputFormatContext, packet) >= 0) {
         if (packet->stream_index == videoStream->index) {
+            reportProgress(packet, lastPercent);
             avcodec_send_packet(videoDecoderContext, packet);
-            AVFrame* frame = av_frame_alloc();
-            if (avcodec_receive_frame(videoDecoderContext, frame) == 0) {
-                avcodec_send_frame(videoEncoderContext, frame);
-                AVPacket* outputPacket = av_packet_alloc();
-                if (avcodec_receive_packet(videoEncoderContext, outputPacket) == 0) {
-                    outputPacket->stream_index = outputVideoStream->index;
-                    av_interleaved_write_frame(outputFormatContext, outputPacket);
-                    av_packet_unref(outputPacket);
-                }
-                av_packet_free(&outputPacket);
-            }
-            av_frame_free(&frame);
+            pushDecodedFrames();
         }
         else if (packet->stream_index == audioStream->index) {
             // Process audio frames.
@@ -180,8 +190,9 @@ void VideoConverter::encodeAndWriteFrames() {
                 avcodec_send_frame(audioEncoderContext, frame);
                 AVPacket* outputPacket = av_packet_alloc();
                 if (avcodec_receive_packet(audioEncoderContext, outputPacket) == 0) {
-                    outputPacket->stream_index = outputAudioStream->index;
-                    av_interleaved_write_frame(outputFormatContext, outputPacket);
+                    for (auto& output : outputs) {
+                        output->pushAudioPacket(outputPacket, audioEncoderContext->time_base);
+                    }
                     av_packet_unref(outputPacket);
                 }
                 av_packet_free(&outputPacket);
@@ -191,66 +202,147 @@ void VideoConverter::encodeAndWriteFrames() {
         av_packet_unref(packet);
     }
     av_packet_free(&packet);
+
+    // Drain the frames the decoder still holds back (reordering, frame threads).
+    avcodec_send_packet(videoDecoderContext, nullptr);
+    pushDecodedFrames();
 }
 
-// Flushes the encoders to ensure all remaining frames are processed.
-void VideoConverter::flushEncoders() {
-    AVPacket* packet = av_packet_alloc();
+// Hands every frame the video decoder has ready to all renditions.
+void VideoConverter::pushDecodedFrames() {
+    AVFrame* frame = av_frame_alloc();
+    while (avcodec_receive_frame(videoDecoderContext, frame) == 0) {
+        // Renditions take a reference to the decoded frame, not a copy.
+        for (auto& output : outputs) {
+            output->pushFrame(frame);
+        }
+        av_frame_unref(frame);
+    }
+    av_frame_free(&frame);
+}
 
-    // Flush video encoder
-    avcodec_send_frame(videoEncoderContext, nullptr);
-    while (avcodec_receive_packet(videoEncoderContext, packet) == 0) {
-        packet->stream_index = outputVideoStream->index;
-        av_interleaved_write_frame(outputFormatContext, packet);
-        av_packet_unref(packet);
+// Calls the progress callback whenever another whole percent of the input has been read.
+void VideoConverter::reportProgress(const AVPacket* packet, int& lastPercent) {
+    if (!progressCallback || packet->pts == AV_NOPTS_VALUE) {
+        return;
+    }
+    int64_t duration = videoStream->duration > 0 ? videoStream->duration
+        : av_rescale_q(inputFormatContext->duration, av_make_q(1, AV_TIME_BASE), videoStream->time_base);
+    if (duration <= 0) {
+        return;
+    }
+    int64_t start = videoStream->start_time != AV_NOPTS_VALUE ? videoStream->start_time : 0;
+    double fraction = FFMIN(1.0, FFMAX(0.0, static_cast<double>(packet->pts - start) / duration));
+    int percent = static_cast<int>(fraction * 100);
+    if (percent > lastPercent) {
+        lastPercent = percent;
+        progressCallback(fraction);
     }
+}
+
+// Flushes the encoders to ensure all remaining frames are processed.
+bool VideoConverter::flushEncoders() {
+    AVPacket* packet = av_packet_alloc();
 
     // Flush audio encoder
     avcodec_send_frame(audioEncoderContext, nullptr);
     while (avcodec_receive_packet(audioEncoderContext, packet) == 0) {
-        packet->stream_index = outputAudioStream->index;
-        av_interleaved_write_frame(outputFormatContext, packet);
+        for (auto& output : outputs) {
+            output->pushAudioPacket(packet, audioEncoderContext->time_base);
+        }
         av_packet_unref(packet);
     }
 
     av_packet_free(&packet);
+
+    // Flush video encoders; all renditions drain in parallel before we wait on any.
+    for (auto& output : outputs) {
+        output->finish();
+    }
+    for (auto& output : outputs) {
+        output->wait();
+    }
+    bool success = true;
+    for (auto& output : outputs) {
+        if (!output->finalize()) {
+            std::cerr << "Could not finalize output file " << output->filename() << std::endl;
+            success = false;
+        }
+    }
+    reportQuality();
+    return success;
+}
+
+// Collects and prints the PSNR/SSIM totals of every rendition that measured them.
+void VideoConverter::reportQuality() {
+    for (const auto& output : outputs) {
+        const QualityMeter* meter = output->quality();
+        if (!meter) {
+            continue;
+        }
+        QualityReport report{ output->filename(), output->pixelFormat(), meter->summary() };
+        if (verbose) {
+            std::cout << "Quality of " << report.outputFilename << " (" << report.summary.frames << " frames, "
+                      << QualityMeter::kernelName() << " kernels): "
+                      << QualityMeter::format(report.summary.plane, report.summary.planes, report.summary.all, report.pixelFormat) << std::endl;
+        }
+        qualityResults.push_back(report);
+    }
 }
 
-// Cleans up and releases all allocated resources.
+// Releases everything the job allocated; the converter can then run another job.
 void VideoConverter::cleanup() {
-    av_write_trailer(outputFormatContext);
-    avio_closep(&outputFormatContext->pb);
+    for (auto& output : outputs) {
+        output->finish();
+        output->wait();
+        output->cleanup();
+    }
+    outputs.clear();
     avcodec_free_context(&audioEncoderContext);
-    avcodec_free_context(&videoEncoderContext);
-    avformat_free_context(outputFormatContext);
     avcodec_free_context(&audioDecoderContext);
     avcodec_free_context(&videoDecoderContext);
     avformat_close_input(&inputFormatContext);
+    asyncInput.close();
+    videoStream = nullptr;
+    audioStream = nullptr;
+}
+
+void VideoConverter::reset(const std::string& inputFilename, const std::vector<Rendition>& renditions) {
+    cleanup();
+    this->inputFilename = inputFilename;
+    this->renditions = renditions;
 }
 
 // Main function to convert the input video to HEVC format.
-void VideoConverter::convertToHEVC() {
+bool VideoConverter::convertToHEVC() {
+    qualityResults.clear();
     if (!openInputFile()) {
-        return;
+        cleanup();
+        return false;
     }
     if (!initializeOutputFile()) {
         cleanup();
-        return;
+        return false;
     }
     if (!initializeDecoderContexts()) {
         cleanup();
-        return;
+        return false;
     }
     if (!initializeEncoderContexts()) {
         cleanup();
-        return;
+        return false;
     }
     if (!writeOutputContext()) {
         cleanup();
-        return;
+        return false;
+    }
+    if (!seekToCheckpoint()) {
+        cleanup();
+        return false;
     }
 
     encodeAndWriteFrames();
-    flushEncoders();
+    bool success = flushEncoders();
     cleanup();
+    return success;
 }
\ No newline at end of file
@@ -2,8 +2,15 @@
 #ifndef VIDECONVERTER_H
 #define VIDECONVERTER_H
 
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "AsyncIO.hpp"
+#include "FrameScaler.hpp"
+#include "RenditionOutput.hpp"
 
 extern "C"
 {
@@ -14,37 +21,74 @@ extern "C"
     #include <libswscale/swscale.h>
 }
 
+// Quality totals of one rendition of the last conversion.
+struct QualityReport {
+    std::string outputFilename;
+    AVPixelFormat pixelFormat;
+    QualitySummary summary;
+};
+
 class VideoConverter {
 public:
-    VideoConverter(const std::string& inputFilename, const std::string& outputFilename)
-        : inputFilename(inputFilename), outputFilename(outputFilename) 
+    VideoConverter(const std::string& inputFilename, const std::string& outputFilename, const ScalingOptions& scalingOptions = {})
+        : inputFilename(inputFilename), renditions{ { outputFilename, scalingOptions } }
     {
         av_log_set_level(AV_LOG_DEBUG);
     }
-    void convertToHEVC();
+    // ABR ladder: the input is decoded once and every rendition is encoded from the same frames.
+    VideoConverter(const std::string& inputFilename, const std::vector<Rendition>& renditions)
+        : inputFilename(inputFilename), renditions(renditions)
+    {
+        av_log_set_level(AV_LOG_DEBUG);
+    }
+    // Checkpoint every ~intervalSeconds so that a restarted job resumes instead of starting over.
+    void setCheckpointInterval(int intervalSeconds) { checkpointInterval = intervalSeconds; }
+    // Measure PSNR/SSIM of every output against its encoder input while converting; threads
+    // per rendition for the metric kernels, 0 = one per core.
+    void setQualityMetrics(bool enabled, int threads = 0) { measureQuality = enabled; qualityThreads = threads; }
+    // Called from the decoding thread with the fraction of the input read so far (0..1).
+    void setProgressCallback(std::function<void(double)> callback) { progressCallback = std::move(callback); }
+    // Whether to print resume and quality summaries to std::cout; off when jobs run in parallel.
+    void setVerbose(bool enabled) { verbose = enabled; }
+    // Points a finished converter at the next job. Scaler contexts pooled by earlier jobs are kept.
+    void reset(const std::string& inputFilename, const std::vector<Rendition>& renditions);
+    bool convertToHEVC();
+    // Filled at the end of convertToHEVC() when quality metrics are enabled.
+    const std::vector<QualityReport>& qualityReports() const { return qualityResults; }
 
 private:
     std::string inputFilename;
-    std::string outputFilename;
+    std::vector<Rendition> renditions;
+    int checkpointInterval = 0;
+    bool measureQuality = false;
+    int qualityThreads = 0;
+    std::function<void(double)> progressCallback;
+    bool verbose = true;
+    std::vector<QualityReport> qualityResults;
 
     AVFormatContext* inputFormatContext = nullptr;
     AVCodecContext* videoDecoderContext = nullptr;
     AVCodecContext* audioDecoderContext = nullptr;
-    AVCodecContext* videoEncoderContext = nullptr;
     AVCodecContext* audioEncoderContext = nullptr;
-    AVFormatContext* outputFormatContext = nullptr;
     AVStream* videoStream = nullptr;
     AVStream* audioStream = nullptr;
-    AVStream* outputVideoStream = nullptr;
-    AVStream* outputAudioStream = nullptr;
+
+    AsyncInputFile asyncInput;
+    std::vector<std::unique_ptr<RenditionOutput>> outputs;
+    // One per rendition slot; outlives the outputs so a reused converter keeps its contexts.
+    std::vector<std::unique_ptr<SwsContextPool>> scalerPools;
 
     bool openInputFile();
     bool initializeDecoderContexts();
     bool initializeOutputFile();
     bool initializeEncoderContexts();
     bool writeOutputContext();
+    bool seekToCheckpoint();
     void encodeAndWriteFrames();
-    void flushEncoders();
+    void pushDecodedFrames();
+    bool flushEncoders();
+    void reportQuality();
+    void reportProgress(const AVPacket* packet, int& lastPercent);
     void cleanup();
 public:
 
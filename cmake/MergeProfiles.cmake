@@ -0,0 +1,14 @@
+# Merges the raw Clang profiles written by a PGO GENERATE build into default.profdata.
+# Usage: cmake -DPROFDATA=<llvm-profdata> -DPROFILE_DIR=<dir> -P MergeProfiles.cmake
+
+file(GLOB rawProfiles "${PROFILE_DIR}/*.profraw")
+if(NOT rawProfiles)
+    message(FATAL_ERROR "No .profraw files in ${PROFILE_DIR}")
+endif()
+execute_process(
+    COMMAND ${PROFDATA} merge -output=${PROFILE_DIR}/default.profdata ${rawProfiles}
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "llvm-profdata merge failed")
+endif()
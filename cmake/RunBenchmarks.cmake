@@ -0,0 +1,106 @@
+# Runs the CLI benchmark modes on the bundled samples and records the results.
+# Usage: cmake -DCLI=<exe> -DSAMPLE_DIR=<dir> -DRUN_DIR=<dir> -DRESULTS=<file>
+#              [-DBASELINE=<results of another build>] [-DLABEL=<text>] -P RunBenchmarks.cmake
+#
+# Results are key=value lines; every value is "higher is better" so a baseline comparison
+# is just current / baseline.
+
+file(MAKE_DIRECTORY ${RUN_DIR})
+set(movie ${SAMPLE_DIR}/Big_Buck_Bunny.mp4)
+set(hevc ${RUN_DIR}/bench.mp4)
+
+# Runs the CLI and stores the first capture group of pattern from its output in outVar.
+function(run_benchmark outVar pattern)
+    execute_process(
+        COMMAND ${CLI} ${ARGN}
+        WORKING_DIRECTORY ${RUN_DIR}
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE output
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${CLI} ${ARGN} failed:\n${output}")
+    endif()
+    if(pattern AND NOT output MATCHES "${pattern}")
+        message(FATAL_ERROR "Unexpected benchmark output:\n${output}")
+    endif()
+    set(${outVar} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+endfunction()
+
+# Decimal string to an integer in thousandths, CMake math only knows integers.
+function(to_milli outVar value)
+    if(NOT value MATCHES "^([0-9]+)(\\.([0-9]*))?$")
+        message(FATAL_ERROR "Cannot compare non-decimal value '${value}'")
+    endif()
+    set(fraction "${CMAKE_MATCH_3}000")
+    string(SUBSTRING "${fraction}" 0 3 fraction)
+    math(EXPR milli "${CMAKE_MATCH_1} * 1000 + 1${fraction} - 1000")
+    set(${outVar} ${milli} PARENT_SCOPE)
+endfunction()
+
+set(results "")
+
+# Conversion throughput, which also produces the HEVC file the SPS benchmark reads.
+if(CMAKE_VERSION VERSION_GREATER_EQUAL 3.23)
+    string(TIMESTAMP start "%s%f")
+endif()
+run_benchmark(unused "" -i ${movie} -o ${hevc} -convert)
+if(CMAKE_VERSION VERSION_GREATER_EQUAL 3.23)
+    string(TIMESTAMP end "%s%f")
+    math(EXPR elapsedMs "(${end} - ${start}) / 1000")
+    if(elapsedMs GREATER 0)
+        math(EXPR convertsPerHour "3600000 / ${elapsedMs}")
+        list(APPEND results "convert_runs_per_hour=${convertsPerHour}")
+        message(STATUS "Converted ${movie} in ${elapsedMs} ms")
+    endif()
+endif()
+
+run_benchmark(spsPerSecond " ([0-9]+) SPS/s" -i ${movie} -o ${hevc} -bench--sps)
+list(APPEND results "sps_per_second=${spsPerSecond}")
+
+foreach(image blueGiant cactus_tree)
+    run_benchmark(mpixels " ([0-9.]+) Mpixel/s" -i ${movie} -o ${hevc} -bench--color ${SAMPLE_DIR}/${image}.jpg)
+    list(APPEND results "color_${image}_mpixel_per_second=${mpixels}")
+endforeach()
+
+string(REPLACE ";" "\n" content "${results}")
+file(WRITE ${RESULTS} "# ${LABEL}\n${content}\n")
+message(STATUS "Benchmark results (${LABEL}) written to ${RESULTS}")
+foreach(entry IN LISTS results)
+    message(STATUS "  ${entry}")
+endforeach()
+
+if(NOT BASELINE)
+    return()
+endif()
+if(NOT EXISTS ${BASELINE})
+    message(WARNING "Baseline ${BASELINE} does not exist, no speedup reported")
+    return()
+endif()
+
+file(STRINGS ${BASELINE} baselineEntries REGEX "^[A-Za-z_]+=")
+message(STATUS "Speedup against ${BASELINE}:")
+foreach(entry IN LISTS results)
+    string(REGEX MATCH "^([A-Za-z_]+)=(.*)$" unused "${entry}")
+    set(key ${CMAKE_MATCH_1})
+    set(current ${CMAKE_MATCH_2})
+    set(baseline "")
+    foreach(baselineEntry IN LISTS baselineEntries)
+        if(baselineEntry MATCHES "^${key}=(.*)$")
+            set(baseline ${CMAKE_MATCH_1})
+        endif()
+    endforeach()
+    if(baseline STREQUAL "")
+        continue()
+    endif()
+    to_milli(currentMilli ${current})
+    to_milli(baselineMilli ${baseline})
+    if(baselineMilli EQUAL 0)
+        continue()
+    endif()
+    math(EXPR ratio "${currentMilli} * 1000 / ${baselineMilli}")
+    math(EXPR whole "${ratio} / 1000")
+    math(EXPR fraction "${ratio} % 1000 + 1000")
+    string(SUBSTRING ${fraction} 1 3 fraction)
+    message(STATUS "  ${key}: ${baseline} -> ${current} (${whole}.${fraction}x)")
+endforeach()
@@ -0,0 +1,151 @@
+#include "Checkpoint.hpp"
+#include "TestCheck.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+CheckpointState sampleState() {
+    CheckpointState state;
+    state.segmentStarts = { 0, 3000, 6000 };
+    state.videoResumePts = 9000;
+    state.audioResumePts = 144000;
+    state.outputBytes = 1234567;
+    state.complete = true;
+    state.width = 1280;
+    state.height = 720;
+    state.pixelFormat = 0;
+    state.videoTimeBase = { 1, 12800 };
+    state.audioTimeBase = { 1, 48000 };
+    state.gopSize = 25;
+    state.maxBFrames = 2;
+    state.bitRate = 4000000;
+    state.inputPath = "/media/some input.mp4";
+    state.inputSize = 5510872;
+    state.inputModified = 1700000000123;
+    return state;
+}
+
+void writeFile(const std::string& path, const std::string& contents) {
+    std::ofstream file(path, std::ios::trunc);
+    file << contents;
+}
+
+void testRoundTrip(const std::string& path) {
+    CheckpointState saved = sampleState();
+    CHECK(saved.save(path));
+    CHECK(!std::filesystem::exists(path + ".tmp"));
+
+    CheckpointState loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.segmentStarts == saved.segmentStarts);
+    CHECK(loaded.segments() == 3);
+    CHECK(loaded.videoResumePts == saved.videoResumePts);
+    CHECK(loaded.audioResumePts == saved.audioResumePts);
+    CHECK(loaded.outputBytes == saved.outputBytes);
+    CHECK(loaded.complete);
+    CHECK(loaded.sameEncoderConfig(saved));
+    CHECK(loaded.sameInput(saved));
+
+    // Saving again replaces the previous state.
+    saved.complete = false;
+    saved.segmentStarts.push_back(9000);
+    CHECK(saved.save(path));
+    CHECK(loaded.load(path));
+    CHECK(!loaded.complete);
+    CHECK(loaded.segments() == 4);
+}
+
+void testEncoderConfig() {
+    CheckpointState base = sampleState();
+    CheckpointState other = base;
+    CHECK(base.sameEncoderConfig(other));
+    other.maxBFrames = 0;
+    CHECK(!base.sameEncoderConfig(other));
+    other = base;
+    other.bitRate = 2000000;
+    CHECK(!base.sameEncoderConfig(other));
+    other = base;
+    other.videoTimeBase = { 1, 25 };
+    CHECK(!base.sameEncoderConfig(other));
+    other = base;
+    other.gopSize = 50;
+    CHECK(!base.sameEncoderConfig(other));
+}
+
+void testInputIdentity(const std::string& directory) {
+    std::string input = directory + "/input.bin";
+    writeFile(input, "first contents");
+
+    CheckpointState first;
+    first.identifyInput(input);
+    CHECK(std::filesystem::path(first.inputPath).is_absolute());
+    CHECK(first.inputSize == 14);
+
+    CheckpointState again;
+    again.identifyInput(input);
+    CHECK(first.sameInput(again));
+
+    // A changed input must not be mistaken for the one the segments were made from.
+    writeFile(input, "second, longer contents");
+    CheckpointState changed;
+    changed.identifyInput(input);
+    CHECK(!first.sameInput(changed));
+
+    std::string renamed = directory + "/renamed.bin";
+    std::filesystem::rename(input, renamed);
+    CheckpointState moved;
+    moved.identifyInput(renamed);
+    CHECK(!changed.sameInput(moved));
+
+    // Inputs that are not files are identified by name only.
+    CheckpointState url;
+    url.identifyInput("rtmp://example.invalid/live");
+    CHECK(url.inputSize == -1);
+    CHECK(!url.inputPath.empty());
+
+    CheckpointState empty;
+    CHECK(!empty.sameInput(empty));
+}
+
+void testInvalidFiles(const std::string& directory) {
+    CheckpointState state = sampleState();
+    CheckpointState loaded = state;
+
+    CHECK(!loaded.load(directory + "/missing.checkpoint"));
+    CHECK(!state.save(directory + "/missing/output.checkpoint"));
+
+    std::string path = directory + "/invalid.checkpoint";
+    writeFile(path, "segment_start=0\nwidth=wide\n");
+    CHECK(!loaded.load(path));
+
+    writeFile(path, "segment_start=0\nvideo_time_base=1/0\n");
+    CHECK(!loaded.load(path));
+
+    // A state file without any completed segment has nothing to resume.
+    writeFile(path, "video_resume_pts=100\n");
+    CHECK(!loaded.load(path));
+
+    // A failed load leaves the state untouched.
+    CHECK(loaded.segmentStarts == state.segmentStarts);
+    CHECK(loaded.sameEncoderConfig(state));
+}
+
+} // namespace
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "CheckpointTests";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    testRoundTrip((directory / "output.checkpoint").string());
+    testEncoderConfig();
+    testInputIdentity(directory.string());
+    testInvalidFiles(directory.string());
+
+    std::filesystem::remove_all(directory);
+    return testResult();
+}
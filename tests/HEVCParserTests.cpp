@@ -0,0 +1,361 @@
+#include "HEVCParser.hpp"
+#include "TestCheck.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+
+// MSB-first writer for building RBSPs.
+class BitWriter {
+public:
+    void writeBits(uint32_t value, int numBits) {
+        for (int i = numBits - 1; i >= 0; --i) {
+            writeBit((value >> i) & 1);
+        }
+    }
+
+    void writeExpGolombCode(uint32_t value) {
+        uint64_t codeNum = uint64_t(value) + 1;
+        int length = 0;
+        while ((codeNum >> (length + 1)) != 0) {
+            ++length;
+        }
+        writeBits(0, length);
+        writeBits(static_cast<uint32_t>(codeNum), length + 1);
+    }
+
+    // rbsp_trailing_bits: a stop bit, then zeros up to the byte boundary.
+    std::vector<uint8_t> finish() {
+        writeBit(1);
+        while (bitCount % 8 != 0) {
+            writeBit(0);
+        }
+        return bytes;
+    }
+
+    size_t bitsWritten() const { return bitCount; }
+
+private:
+    std::vector<uint8_t> bytes;
+    size_t bitCount = 0;
+
+    void writeBit(uint32_t bit) {
+        if (bitCount % 8 == 0) {
+            bytes.push_back(0);
+        }
+        bytes.back() |= bit << (7 - bitCount % 8);
+        ++bitCount;
+    }
+};
+
+struct SpsFields {
+    uint32_t maxSubLayersMinus1 = 0;
+    uint32_t profileSpace = 0;
+    uint32_t tierFlag = 0;
+    uint32_t profileIdc = 1;
+    uint32_t levelIdc = 93;
+    uint32_t chromaFormatIdc = 1;
+    uint32_t separateColourPlane = 0;
+    uint32_t width = 1920;
+    uint32_t height = 1088;
+    bool conformanceWindow = true;
+    uint32_t confWin[4] = { 0, 0, 0, 4 };  // left, right, top, bottom
+    uint32_t bitDepthLumaMinus8 = 0;
+    uint32_t bitDepthChromaMinus8 = 0;
+};
+
+// Inserts an emulation prevention byte wherever two zero bytes are followed by a byte <= 3.
+std::vector<uint8_t> escape(const std::vector<uint8_t>& rbsp) {
+    std::vector<uint8_t> escaped;
+    int zeroRun = 0;
+    for (uint8_t byte : rbsp) {
+        if (zeroRun >= 2 && byte <= 3) {
+            escaped.push_back(0x03);
+            zeroRun = 0;
+        }
+        escaped.push_back(byte);
+        zeroRun = byte == 0 ? zeroRun + 1 : 0;
+    }
+    return escaped;
+}
+
+// A complete SPS NAL unit: two byte header, then the escaped RBSP. parsedBytes receives the
+// length of the prefix the parser has to read, everything after it may be cut off.
+std::vector<uint8_t> makeSps(const SpsFields& fields, size_t* parsedBytes = nullptr) {
+    BitWriter writer;
+    writer.writeBits(0, 4);  // sps_video_parameter_set_id
+    writer.writeBits(fields.maxSubLayersMinus1, 3);
+    writer.writeBits(1, 1);  // sps_temporal_id_nesting_flag
+    writer.writeBits(fields.profileSpace, 2);
+    writer.writeBits(fields.tierFlag, 1);
+    writer.writeBits(fields.profileIdc, 5);
+    writer.writeBits(0, 32);  // general_profile_compatibility_flag, zero so that escapes are needed
+    writer.writeBits(0, 32);  // source and constraint flags
+    writer.writeBits(0, 16);
+    writer.writeBits(fields.levelIdc, 8);
+    for (uint32_t i = 0; i < fields.maxSubLayersMinus1; ++i) {
+        writer.writeBits(1, 1);  // sub_layer_profile_present_flag
+        writer.writeBits(i % 2, 1);  // sub_layer_level_present_flag
+    }
+    if (fields.maxSubLayersMinus1 > 0) {
+        writer.writeBits(0, 2 * (8 - fields.maxSubLayersMinus1));
+    }
+    for (uint32_t i = 0; i < fields.maxSubLayersMinus1; ++i) {
+        writer.writeBits(0x5A5A5A, 24);  // sub-layer profile, 88 bits
+        writer.writeBits(0x5A5A5A, 24);
+        writer.writeBits(0x5A5A5A, 24);
+        writer.writeBits(0x5A5A, 16);
+        if (i % 2) {
+            writer.writeBits(0xFF, 8);  // sub_layer_level_idc
+        }
+    }
+    writer.writeExpGolombCode(0);  // sps_seq_parameter_set_id
+    writer.writeExpGolombCode(fields.chromaFormatIdc);
+    if (fields.chromaFormatIdc == 3) {
+        writer.writeBits(fields.separateColourPlane, 1);
+    }
+    writer.writeExpGolombCode(fields.width);
+    writer.writeExpGolombCode(fields.height);
+    writer.writeBits(fields.conformanceWindow, 1);
+    if (fields.conformanceWindow) {
+        for (uint32_t offset : fields.confWin) {
+            writer.writeExpGolombCode(offset);
+        }
+    }
+    writer.writeExpGolombCode(fields.bitDepthLumaMinus8);
+    writer.writeExpGolombCode(fields.bitDepthChromaMinus8);
+    size_t parsedBits = writer.bitsWritten();
+    writer.writeExpGolombCode(4);  // log2_max_pic_order_cnt_lsb_minus4, not read by the parser
+    std::vector<uint8_t> rbsp = writer.finish();
+
+    std::vector<uint8_t> nalUnit = { 0x42, 0x01 };  // nal_unit_type 33, layer 0, temporal id 0
+    std::vector<uint8_t> escaped = escape(rbsp);
+    nalUnit.insert(nalUnit.end(), escaped.begin(), escaped.end());
+    if (parsedBytes) {
+        std::vector<uint8_t> prefix(rbsp.begin(), rbsp.begin() + (parsedBits + 7) / 8);
+        *parsedBytes = 2 + escape(prefix).size();
+    }
+    return nalUnit;
+}
+
+const std::vector<uint8_t> vps = { 0x40, 0x01, 0x0C, 0x01, 0xFF, 0xFF };
+const std::vector<uint8_t> pps = { 0x44, 0x01, 0xC1, 0x72, 0xB4, 0x62, 0x40 };
+
+std::vector<uint8_t> annexB(const std::vector<std::vector<uint8_t>>& nalUnits) {
+    std::vector<uint8_t> stream;
+    for (const std::vector<uint8_t>& nalUnit : nalUnits) {
+        stream.insert(stream.end(), { 0x00, 0x00, 0x00, 0x01 });
+        stream.insert(stream.end(), nalUnit.begin(), nalUnit.end());
+    }
+    return stream;
+}
+
+std::vector<uint8_t> lengthPrefixed(const std::vector<std::vector<uint8_t>>& nalUnits, int nalLengthSize) {
+    std::vector<uint8_t> packet;
+    for (const std::vector<uint8_t>& nalUnit : nalUnits) {
+        for (int i = nalLengthSize - 1; i >= 0; --i) {
+            packet.push_back(static_cast<uint8_t>(nalUnit.size() >> (8 * i)));
+        }
+        packet.insert(packet.end(), nalUnit.begin(), nalUnit.end());
+    }
+    return packet;
+}
+
+// HEVCDecoderConfigurationRecord with one array per NAL unit.
+std::vector<uint8_t> hvcC(const std::vector<std::vector<uint8_t>>& nalUnits) {
+    std::vector<uint8_t> record(23, 0);
+    record[0] = 1;     // configurationVersion
+    record[1] = 0x01;  // general_profile_idc
+    record[12] = 93;   // general_level_idc
+    record[21] = 0x0F; // lengthSizeMinusOne = 3
+    record[22] = static_cast<uint8_t>(nalUnits.size());
+    for (const std::vector<uint8_t>& nalUnit : nalUnits) {
+        record.push_back(0x80 | ((nalUnit[0] >> 1) & 0x3F));  // array_completeness, NAL_unit_type
+        record.insert(record.end(), { 0x00, 0x01 });          // numNalus
+        record.push_back(static_cast<uint8_t>(nalUnit.size() >> 8));
+        record.push_back(static_cast<uint8_t>(nalUnit.size()));
+        record.insert(record.end(), nalUnit.begin(), nalUnit.end());
+    }
+    return record;
+}
+
+bool hasEmulationPrevention(const std::vector<uint8_t>& nalUnit) {
+    for (size_t i = 2; i < nalUnit.size(); ++i) {
+        if (nalUnit[i - 2] == 0 && nalUnit[i - 1] == 0 && nalUnit[i] == 3) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isInfo(const HEVCResult<HEVCInfo>& result, int width, int height) {
+    return result.has_value() && result.value().width == width && result.value().height == height;
+}
+
+bool isError(const HEVCResult<HEVCInfo>& result, HEVCError error) {
+    return !result.has_value() && result.error() == error;
+}
+
+void testSps() {
+    SpsFields fields;
+    std::vector<uint8_t> sps = makeSps(fields);
+    // The zero profile flags only parse correctly if the 0x03 bytes are skipped.
+    CHECK(hasEmulationPrevention(sps));
+
+    HEVCResult<HEVCInfo> result = HEVCParser::parseSps(sps);
+    CHECK(isInfo(result, 1920, 1080));
+    if (result) {
+        const HEVCInfo& info = result.value();
+        CHECK(info.profileSpace == 0);
+        CHECK(!info.tierFlag);
+        CHECK(info.profileIdc == 1);
+        CHECK(info.levelIdc == 93);
+        CHECK(info.chromaFormatIdc == 1);
+        CHECK(info.bitDepthLuma == 8);
+        CHECK(info.bitDepthChroma == 8);
+    }
+
+    // 4:4:4 10-bit Main tier with sub-layers: crop offsets are in luma samples.
+    fields.maxSubLayersMinus1 = 3;
+    fields.tierFlag = 1;
+    fields.profileIdc = 4;
+    fields.levelIdc = 153;
+    fields.chromaFormatIdc = 3;
+    fields.width = 3840;
+    fields.height = 2160;
+    fields.confWin[0] = 8;
+    fields.confWin[3] = 0;
+    fields.bitDepthLumaMinus8 = 2;
+    fields.bitDepthChromaMinus8 = 2;
+    result = HEVCParser::parseSps(makeSps(fields));
+    CHECK(isInfo(result, 3832, 2160));
+    if (result) {
+        const HEVCInfo& info = result.value();
+        CHECK(info.tierFlag);
+        CHECK(info.profileIdc == 4);
+        CHECK(info.levelIdc == 153);
+        CHECK(info.chromaFormatIdc == 3);
+        CHECK(info.bitDepthLuma == 10);
+        CHECK(info.bitDepthChroma == 10);
+    }
+
+    fields = SpsFields();
+    fields.conformanceWindow = false;
+    CHECK(isInfo(HEVCParser::parseSps(makeSps(fields)), 1920, 1088));
+}
+
+void testInvalidSps() {
+    CHECK(isError(HEVCParser::parseSps(vps), HEVCError::NotSps));
+    CHECK(isError(HEVCParser::parseSps(pps), HEVCError::NotSps));
+
+    SpsFields fields;
+    fields.maxSubLayersMinus1 = 7;
+    CHECK(isError(HEVCParser::parseSps(makeSps(fields)), HEVCError::InvalidSyntax));
+
+    fields = SpsFields();
+    fields.chromaFormatIdc = 4;
+    CHECK(isError(HEVCParser::parseSps(makeSps(fields)), HEVCError::InvalidSyntax));
+
+    fields = SpsFields();
+    fields.width = 0;
+    CHECK(isError(HEVCParser::parseSps(makeSps(fields)), HEVCError::InvalidSyntax));
+
+    fields = SpsFields();
+    fields.confWin[3] = 544;  // crops the whole picture
+    CHECK(isError(HEVCParser::parseSps(makeSps(fields)), HEVCError::InvalidSyntax));
+
+    fields = SpsFields();
+    fields.bitDepthLumaMinus8 = 9;
+    CHECK(isError(HEVCParser::parseSps(makeSps(fields)), HEVCError::InvalidSyntax));
+}
+
+void testTruncatedSps() {
+    size_t parsedBytes = 0;
+    std::vector<uint8_t> sps = makeSps(SpsFields(), &parsedBytes);
+    CHECK(parsedBytes > 2 && parsedBytes <= sps.size());
+
+    std::span<const uint8_t> nalUnit(sps);
+    for (size_t length = 0; length < parsedBytes; ++length) {
+        HEVCResult<HEVCInfo> result = HEVCParser::parseSps(nalUnit.first(length));
+        CHECK(isError(result, HEVCError::Truncated));
+        if (!isError(result, HEVCError::Truncated)) {
+            std::cerr << "SPS cut to " << length << " bytes was not reported as truncated" << std::endl;
+        }
+    }
+    CHECK(isInfo(HEVCParser::parseSps(nalUnit.first(parsedBytes)), 1920, 1080));
+}
+
+void testExtradata() {
+    std::vector<uint8_t> sps = makeSps(SpsFields());
+
+    std::vector<uint8_t> record = hvcC({ vps, sps, pps });
+    std::vector<uint8_t> stream = annexB({ vps, sps, pps });
+    CHECK(isInfo(HEVCParser::parseExtradata(record), 1920, 1080));
+    CHECK(isInfo(HEVCParser::parseExtradata(stream), 1920, 1080));
+
+    // Three byte start codes and trailing zeros after the SPS.
+    std::vector<uint8_t> shortStartCodes = { 0x00, 0x00, 0x01 };
+    shortStartCodes.insert(shortStartCodes.end(), sps.begin(), sps.end());
+    shortStartCodes.insert(shortStartCodes.end(), { 0x00, 0x00, 0x00, 0x01 });
+    shortStartCodes.insert(shortStartCodes.end(), pps.begin(), pps.end());
+    CHECK(isInfo(HEVCParser::parseExtradata(shortStartCodes), 1920, 1080));
+
+    CHECK(isError(HEVCParser::parseExtradata(hvcC({ vps, pps })), HEVCError::SpsNotFound));
+    CHECK(isError(HEVCParser::parseExtradata(annexB({ vps, pps })), HEVCError::SpsNotFound));
+    CHECK(isError(HEVCParser::parseExtradata({}), HEVCError::SpsNotFound));
+
+    // Cut inside the fixed fields, an array header, a NAL unit length and a NAL unit.
+    std::span<const uint8_t> full(record);
+    size_t spsArray = 23 + 5 + vps.size();
+    for (size_t length : { size_t(10), size_t(24), spsArray + 4, spsArray + 5 + sps.size() / 2 }) {
+        CHECK(isError(HEVCParser::parseExtradata(full.first(length)), HEVCError::Truncated));
+    }
+
+    // A record that claims more arrays than it holds.
+    std::vector<uint8_t> missingArrays = hvcC({ vps, pps });
+    missingArrays[22] = 3;
+    CHECK(isError(HEVCParser::parseExtradata(missingArrays), HEVCError::Truncated));
+}
+
+void testPackets() {
+    std::vector<uint8_t> sps = makeSps(SpsFields());
+
+    for (int nalLengthSize : { 1, 2, 4 }) {
+        std::vector<uint8_t> packet = lengthPrefixed({ vps, sps, pps }, nalLengthSize);
+        CHECK(isInfo(HEVCParser::parsePacket(packet, nalLengthSize), 1920, 1080));
+        CHECK(isError(HEVCParser::parsePacket(lengthPrefixed({ vps, pps }, nalLengthSize), nalLengthSize), HEVCError::SpsNotFound));
+
+        // A NAL unit length running past the end of the packet.
+        std::vector<uint8_t> overlong = lengthPrefixed({ vps, sps }, nalLengthSize);
+        overlong[nalLengthSize + vps.size() + nalLengthSize - 1] += 1;
+        CHECK(isError(HEVCParser::parsePacket(overlong, nalLengthSize), HEVCError::Truncated));
+        std::vector<uint8_t> cut(packet.begin(), packet.begin() + nalLengthSize + vps.size() + nalLengthSize + 4);
+        CHECK(isError(HEVCParser::parsePacket(cut, nalLengthSize), HEVCError::Truncated));
+    }
+
+    std::vector<uint8_t> packet = lengthPrefixed({ vps, sps, pps }, 4);
+    // Length sizes hvcC cannot signal, even when the packet happens to parse with them.
+    std::vector<uint8_t> threeBytePacket = lengthPrefixed({ vps, sps, pps }, 3);
+    CHECK(isError(HEVCParser::parsePacket(threeBytePacket, 3), HEVCError::InvalidSyntax));
+    for (int nalLengthSize : { -1, 3, 5, 8 }) {
+        CHECK(isError(HEVCParser::parsePacket(packet, nalLengthSize), HEVCError::InvalidSyntax));
+    }
+    // Length prefixed data read as Annex B has no start codes.
+    CHECK(isError(HEVCParser::parsePacket(packet, 0), HEVCError::SpsNotFound));
+
+    CHECK(isInfo(HEVCParser::parsePacket(annexB({ vps, sps, pps }), 0), 1920, 1080));
+    CHECK(isInfo(HEVCParser::parsePacket(annexB({ vps, sps, pps })), 1920, 1080));
+}
+
+} // namespace
+
+int main() {
+    testSps();
+    testInvalidSps();
+    testTruncatedSps();
+    testExtradata();
+    testPackets();
+    return testResult();
+}
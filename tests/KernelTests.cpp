@@ -0,0 +1,172 @@
+#include "ColorConversionKernels.hpp"
+#include "CpuFeatures.hpp"
+#include "QualityMetricsKernels.hpp"
+#include "TestCheck.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Every ISA translation unit has to produce the same results as the scalar one, and the
+// scalar quality kernels have to match a direct evaluation of the metric definitions.
+namespace {
+
+const int widths[] = { 1, 7, 8, 31, 32, 33, 64, 257, 1921 };
+
+void testColorKernels(const ColorConversionKernels& kernels, std::mt19937& random) {
+    const ColorConversionKernels& scalar = scalarColorConversionKernels();
+    ColorRowKernel ColorConversionKernels::* rowKernels[] = {
+        &ColorConversionKernels::bt2020,
+        &ColorConversionKernels::bt2020Unnormalized,
+        &ColorConversionKernels::jpeg,
+    };
+    for (int width : widths) {
+        std::vector<uint8_t> src(3 * width);
+        for (uint8_t& value : src) {
+            value = static_cast<uint8_t>(random());
+        }
+        // Include the extremes of every channel.
+        std::fill(src.begin(), src.begin() + std::min<size_t>(3, src.size()), uint8_t(255));
+
+        for (ColorRowKernel ColorConversionKernels::* rowKernel : rowKernels) {
+            std::vector<uint8_t> expected(3 * width, 0xAA);
+            std::vector<uint8_t> actual(3 * width, 0x55);
+            (scalar.*rowKernel)(src.data(), expected.data(), width);
+            (kernels.*rowKernel)(src.data(), actual.data(), width);
+            CHECK(expected == actual);
+        }
+    }
+}
+
+template <typename T>
+uint64_t referenceSse(const std::vector<T>& a, const std::vector<T>& b) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t difference = static_cast<int64_t>(a[i]) - b[i];
+        sum += static_cast<uint64_t>(difference * difference);
+    }
+    return sum;
+}
+
+// Sum of the SSIM of the 8x8 windows stepped by 4, straight from the definition.
+template <typename T>
+double referenceSsim(const std::vector<T>& a, const std::vector<T>& b, int width, int height, int maxValue) {
+    double sum = 0;
+    for (int y = 0; y + 1 < height / 4; ++y) {
+        for (int x = 0; x + 1 < width / 4; ++x) {
+            double sumA = 0, sumB = 0, sumSquares = 0, sumProducts = 0;
+            for (int j = 0; j < 8; ++j) {
+                for (int i = 0; i < 8; ++i) {
+                    double sampleA = a[(4 * y + j) * width + 4 * x + i];
+                    double sampleB = b[(4 * y + j) * width + 4 * x + i];
+                    sumA += sampleA;
+                    sumB += sampleB;
+                    sumSquares += sampleA * sampleA + sampleB * sampleB;
+                    sumProducts += sampleA * sampleB;
+                }
+            }
+            sum += ssimWindow(sumA, sumB, sumSquares, sumProducts, maxValue);
+        }
+    }
+    return sum;
+}
+
+bool close(double a, double b) {
+    return std::fabs(a - b) <= 1e-9 * std::max(1.0, std::fabs(b));
+}
+
+// Planes of width x height with b a noisy copy of a.
+template <typename T>
+void randomPlanes(std::vector<T>& a, std::vector<T>& b, int width, int height, int maxValue, std::mt19937& random) {
+    a.resize(static_cast<size_t>(width) * height);
+    b.resize(a.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        a[i] = static_cast<T>(random() % (maxValue + 1));
+        int noisy = static_cast<int>(a[i]) + static_cast<int>(random() % 41) - 20;
+        b[i] = static_cast<T>(std::clamp(noisy, 0, maxValue));
+    }
+}
+
+void testQualityKernels8(const QualityMetricsKernels& kernels, std::mt19937& random) {
+    const QualityMetricsKernels& scalar = scalarQualityMetricsKernels();
+    for (int width : widths) {
+        for (int height : { 8, 13, 40 }) {
+            std::vector<uint8_t> a, b;
+            randomPlanes(a, b, width, height, 255, random);
+            ptrdiff_t stride = width;
+            std::vector<uint32_t> scratch(ssimScratchSize(width));
+
+            uint64_t sse = referenceSse(a, b);
+            CHECK(scalar.sse8(a.data(), stride, b.data(), stride, width, 0, height) == sse);
+            CHECK(kernels.sse8(a.data(), stride, b.data(), stride, width, 0, height) == sse);
+
+            int windowRows = height / 4 - 1;
+            double ssim = scalar.ssim8(a.data(), stride, b.data(), stride, width, 0, windowRows, 255, scratch.data());
+            CHECK(close(ssim, referenceSsim(a, b, width, height, 255)));
+            CHECK(kernels.ssim8(a.data(), stride, b.data(), stride, width, 0, windowRows, 255, scratch.data()) == ssim);
+
+            // Bands of window rows add up to the whole plane.
+            int firstBand = windowRows / 2;
+            double banded = kernels.ssim8(a.data(), stride, b.data(), stride, width, 0, firstBand, 255, scratch.data()) +
+                            kernels.ssim8(a.data(), stride, b.data(), stride, width, firstBand, windowRows - firstBand, 255, scratch.data());
+            CHECK(close(banded, ssim));
+        }
+    }
+}
+
+void testQualityKernels16(const QualityMetricsKernels& kernels, std::mt19937& random) {
+    const QualityMetricsKernels& scalar = scalarQualityMetricsKernels();
+    for (int maxValue : { 1023, 65535 }) {
+        for (int width : widths) {
+            int height = 16;
+            std::vector<uint16_t> a, b;
+            randomPlanes(a, b, width, height, maxValue, random);
+            ptrdiff_t stride = width * static_cast<ptrdiff_t>(sizeof(uint16_t));
+            const uint8_t* planeA = reinterpret_cast<const uint8_t*>(a.data());
+            const uint8_t* planeB = reinterpret_cast<const uint8_t*>(b.data());
+            std::vector<uint64_t> scratch(ssimScratchSize(width));
+
+            uint64_t sse = referenceSse(a, b);
+            CHECK(scalar.sse16(planeA, stride, planeB, stride, width, 0, height) == sse);
+            CHECK(kernels.sse16(planeA, stride, planeB, stride, width, 0, height) == sse);
+
+            int windowRows = height / 4 - 1;
+            double ssim = scalar.ssim16(planeA, stride, planeB, stride, width, 0, windowRows, maxValue, scratch.data());
+            CHECK(close(ssim, referenceSsim(a, b, width, height, maxValue)));
+            CHECK(kernels.ssim16(planeA, stride, planeB, stride, width, 0, windowRows, maxValue, scratch.data()) == ssim);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    std::mt19937 random(2020);
+
+    std::vector<const ColorConversionKernels*> colorKernels = { &scalarColorConversionKernels() };
+    std::vector<const QualityMetricsKernels*> qualityKernels = { &scalarQualityMetricsKernels() };
+    if (cpuSupportsAVX2()) {
+        if (avx2ColorConversionKernels()) {
+            colorKernels.push_back(avx2ColorConversionKernels());
+        }
+        if (avx2QualityMetricsKernels()) {
+            qualityKernels.push_back(avx2QualityMetricsKernels());
+        }
+    }
+    if (colorKernels.size() == 1 && qualityKernels.size() == 1) {
+        std::cout << "No AVX2 kernels on this build or CPU, checking the scalar kernels only" << std::endl;
+    }
+
+    for (const ColorConversionKernels* kernels : colorKernels) {
+        std::cout << "Colour kernels: " << kernels->isa << std::endl;
+        testColorKernels(*kernels, random);
+    }
+    for (const QualityMetricsKernels* kernels : qualityKernels) {
+        std::cout << "Quality kernels: " << kernels->isa << std::endl;
+        testQualityKernels8(*kernels, random);
+        testQualityKernels16(*kernels, random);
+    }
+    return testResult();
+}
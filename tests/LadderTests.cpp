@@ -0,0 +1,79 @@
+#include "RenditionOutput.hpp"
+#include "TestCheck.hpp"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+void testSizes() {
+    ScalingOptions base;
+    base.threads = 3;
+    std::vector<Rendition> renditions;
+    CHECK(parseLadder("1080p,1280x720,hd480", "out/movie.mp4", base, renditions));
+    CHECK(renditions.size() == 3);
+    if (renditions.size() != 3) {
+        return;
+    }
+
+    CHECK(renditions[0].outputFilename == "out/movie_1080p.mp4");
+    CHECK(renditions[0].scaling.width == 0);
+    CHECK(renditions[0].scaling.height == 1080);
+    CHECK(renditions[0].scaling.threads == 3);
+
+    CHECK(renditions[1].outputFilename == "out/movie_1280x720.mp4");
+    CHECK(renditions[1].scaling.width == 1280);
+    CHECK(renditions[1].scaling.height == 720);
+
+    CHECK(renditions[2].outputFilename == "out/movie_hd480.mp4");
+    CHECK(renditions[2].scaling.width == 852);
+    CHECK(renditions[2].scaling.height == 480);
+}
+
+void testNames() {
+    ScalingOptions base;
+    std::vector<Rendition> renditions;
+    CHECK(parseLadder("360p", "movie", base, renditions));
+    CHECK(renditions.size() == 1 && renditions[0].outputFilename == "movie_360p");
+
+    // Dots in directory names are not extensions.
+    renditions.clear();
+    CHECK(parseLadder("360p,480p", "out.dir/movie", base, renditions));
+    CHECK(renditions.size() == 2 && renditions[0].outputFilename == "out.dir/movie_360p");
+    renditions.clear();
+    CHECK(parseLadder("360p", "out.dir\\movie.mkv", base, renditions));
+    CHECK(renditions.size() == 1 && renditions[0].outputFilename == "out.dir\\movie_360p.mkv");
+}
+
+void testInvalid() {
+    ScalingOptions base;
+    const char* ladders[] = {
+        "",
+        "720p,",
+        "0p",
+        "99999999999999999999p",
+        "20000p",
+        "p",
+        "-720p",
+        "720q",
+        "1280x",
+        "small",
+    };
+    for (const char* ladder : ladders) {
+        std::vector<Rendition> renditions;
+        bool parsed = parseLadder(ladder, "movie.mp4", base, renditions);
+        CHECK(!parsed);
+        if (parsed) {
+            std::cerr << "accepted ladder \"" << ladder << "\"" << std::endl;
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    testSizes();
+    testNames();
+    testInvalid();
+    return testResult();
+}
@@ -0,0 +1,29 @@
+#ifndef TESTCHECK_H
+#define TESTCHECK_H
+
+#include <iostream>
+
+// Minimal checks for the unit test executables: a failed CHECK reports its location and
+// the test keeps going, main() returns testResult() so CTest sees every failure at once.
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            ++testFailures();                                                              \
+        }                                                                                  \
+    } while (false)
+
+inline int testResult() {
+    if (testFailures() != 0) {
+        std::cerr << testFailures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif